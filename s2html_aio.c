@@ -0,0 +1,467 @@
+/*
+ * Batched File I/O Functions
+ *
+ * This file reads and writes sets of small files step by step: all opens,
+ * then all reads (or writes), then all closes. Files to read get their size
+ * checked first, so files too large to read are never opened or read here.
+ * With io_uring each step is
+ * submitted for up to AIO_RING_DEPTH files in one system call, which is what
+ * makes trees of small files cheap to convert. The ring is set up with the
+ * raw system calls, so no library is needed. Without io_uring (or if the
+ * ring fails) a pool of threads runs the blocking system calls, each thread
+ * taking whole files.
+ *
+ * Reads and writes use explicit offsets, so a step can be repeated safely
+ * (short writes are simply continued by the next round of the step).
+ *
+ * Main features:
+ * - aio_start: Sets up io_uring, or selects the thread pool.
+ * - aio_read_files / aio_write_files: Read or write a set of files.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "s2html_batch.h"
+#include "s2html_aio.h"
+
+#define AIO_THREADS			16
+#define AIO_PROBE_OPS		256
+
+/* io_uring submission and completion rings */
+typedef struct
+{
+	int fd;
+	unsigned entries;
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+} aio_ring_t;
+
+/* progress of one file */
+typedef struct
+{
+	aio_file_t *file;
+	int fd;              // -1 if not open
+	size_t done;         // bytes written so far
+	int is_write;
+	int sized;           // read: the size check is done
+	struct statx stx;    // read: size of the file
+} aio_op_t;
+
+/* backend in use and its ring, used by one caller at a time */
+static aio_backend_e aio_backend = AIO_BACKEND_NONE;
+static aio_ring_t aio_ring;
+
+/********** Utility functions **********/
+
+/* sets up the io_uring rings, returns 0 on success */
+static int aio_ring_setup(void)
+{
+	static const int needed_ops[] = { IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE };
+	struct io_uring_params params;
+	struct io_uring_probe *probe;
+	size_t ring_size, sqes_size;
+	char *ring;
+	void *sqes;
+	int fd, ok, idx;
+
+	memset(&params, 0, sizeof(params));
+	if((fd = syscall(__NR_io_uring_setup, AIO_RING_DEPTH, &params)) < 0)
+		return -1;
+
+	/* every step needs its opcode (Linux 5.6), the rings share one mapping (Linux 5.4) */
+	probe = calloc(1, sizeof(*probe) + AIO_PROBE_OPS * sizeof(struct io_uring_probe_op));
+	ok = probe != NULL && (params.features & IORING_FEAT_SINGLE_MMAP) &&
+		 syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, AIO_PROBE_OPS) == 0;
+	for(idx = 0; ok && idx < (int)(sizeof(needed_ops) / sizeof(needed_ops[0])); idx++)
+		ok = needed_ops[idx] <= probe->last_op && (probe->ops[needed_ops[idx]].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	if(!ok)
+	{
+		close(fd);
+		return -1;
+	}
+
+	ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	if(ring_size < params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe))
+		ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(ring == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if(ring != MAP_FAILED)
+			munmap(ring, ring_size);
+		if(sqes != MAP_FAILED)
+			munmap(sqes, sqes_size);
+		close(fd);
+		return -1;
+	}
+
+	aio_ring.fd = fd;
+	aio_ring.entries = params.sq_entries;
+	aio_ring.sq_tail = (unsigned *)(ring + params.sq_off.tail);
+	aio_ring.sq_mask = (unsigned *)(ring + params.sq_off.ring_mask);
+	aio_ring.sq_array = (unsigned *)(ring + params.sq_off.array);
+	aio_ring.cq_head = (unsigned *)(ring + params.cq_off.head);
+	aio_ring.cq_tail = (unsigned *)(ring + params.cq_off.tail);
+	aio_ring.cq_mask = (unsigned *)(ring + params.cq_off.ring_mask);
+	aio_ring.cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+	aio_ring.sqes = sqes;
+
+	return 0;
+}
+
+/* marks a file as failed in a step */
+static void aio_fail(aio_file_t *file, aio_stage_e stage, int error)
+{
+	file->error = error;
+	file->stage = stage;
+}
+
+/* tells whether a file still needs the given step */
+static int aio_wants(const aio_op_t *op, aio_stage_e stage)
+{
+	switch(stage)
+	{
+		case AIO_STAGE_SIZE:
+			return !op->is_write && op->file->error == 0 && !op->sized;
+		case AIO_STAGE_OPEN:
+			return op->file->error == 0 && op->fd < 0;
+		case AIO_STAGE_TRANSFER:
+			if(op->file->error != 0 || op->fd < 0)
+				return 0;
+			return op->is_write ? op->done < op->file->len : op->file->data == NULL;
+		default:
+			return op->fd >= 0;
+	}
+}
+
+/* allocates the read buffer of a file, one byte more than AIO_READ_SIZE
+ * tells larger files apart. Returns 0 on success.
+ */
+static int aio_read_buffer(aio_op_t *op)
+{
+	if(NULL == (op->file->data = malloc(AIO_READ_SIZE + 1)))
+	{
+		aio_fail(op->file, AIO_STAGE_TRANSFER, ENOMEM);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* applies the result of a step (a file descriptor, byte count or -errno) */
+static void aio_complete(aio_op_t *op, aio_stage_e stage, int res)
+{
+	aio_file_t *file = op->file;
+
+	if(stage == AIO_STAGE_CLOSE)
+	{
+		op->fd = -1;
+		if(res < 0 && file->error == 0)
+			aio_fail(file, stage, -res);
+		return;
+	}
+
+	if(res < 0)
+	{
+		aio_fail(file, stage, -res);
+	}
+	else if(stage == AIO_STAGE_SIZE)
+	{
+		op->sized = 1;
+		if(op->stx.stx_size > AIO_READ_SIZE)
+			aio_fail(file, stage, EFBIG);
+	}
+	else if(stage == AIO_STAGE_OPEN)
+	{
+		op->fd = res;
+	}
+	else if(op->is_write)
+	{
+		if(res == 0)
+			aio_fail(file, stage, EIO);
+		op->done += res;
+	}
+	else if(res > AIO_READ_SIZE)
+	{
+		aio_fail(file, stage, EFBIG);
+	}
+	else
+	{
+		file->len = res;
+	}
+
+	/* failed reads keep no buffer */
+	if(!op->is_write && file->error != 0)
+	{
+		free(file->data);
+		file->data = NULL;
+	}
+}
+
+/* prepares the submission of a step, returns 0 if it is to be submitted */
+static int aio_uring_prep(struct io_uring_sqe *sqe, aio_op_t *op, aio_stage_e stage)
+{
+	aio_file_t *file = op->file;
+
+	memset(sqe, 0, sizeof(*sqe));
+	switch(stage)
+	{
+		case AIO_STAGE_SIZE:
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (unsigned long)file->path;
+			sqe->len = STATX_SIZE;
+			sqe->off = (unsigned long)&op->stx; // addr2, the statx buffer
+			break;
+		case AIO_STAGE_OPEN:
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (unsigned long)file->path;
+			sqe->len = 0666;
+			sqe->open_flags = O_CLOEXEC | (op->is_write ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+			break;
+		case AIO_STAGE_TRANSFER:
+			if(!op->is_write && aio_read_buffer(op) != 0)
+				return -1;
+			sqe->opcode = op->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+			sqe->fd = op->fd;
+			sqe->addr = (unsigned long)(file->data + op->done);
+			sqe->len = op->is_write ? file->len - op->done : AIO_READ_SIZE + 1;
+			sqe->off = op->done;
+			break;
+		default:
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->fd = op->fd;
+			break;
+	}
+
+	return 0;
+}
+
+/* submits 'count' queued operations and waits for all of them, returns 0 on success */
+static int aio_uring_wait(aio_op_t *ops, aio_stage_e stage, unsigned count)
+{
+	struct io_uring_cqe *cqe;
+	unsigned submitted = 0, completed = 0, head;
+	int ret;
+
+	while(completed < count)
+	{
+		ret = syscall(__NR_io_uring_enter, aio_ring.fd, count - submitted, count - completed,
+					  IORING_ENTER_GETEVENTS, NULL, 0);
+		if(ret < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		submitted += ret;
+
+		head = *aio_ring.cq_head;
+		while(head != __atomic_load_n(aio_ring.cq_tail, __ATOMIC_ACQUIRE))
+		{
+			cqe = &aio_ring.cqes[head & *aio_ring.cq_mask];
+			aio_complete(&ops[cqe->user_data], stage, cqe->res);
+			head++;
+			completed++;
+		}
+		__atomic_store_n(aio_ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+/* runs a step through io_uring, returns the number of files it ran for, -1 if the ring failed */
+static int aio_uring_step(aio_op_t *ops, int nops, aio_stage_e stage)
+{
+	unsigned tail, slot, queued;
+	int idx = 0, ran = 0;
+
+	while(idx < nops)
+	{
+		queued = 0;
+		tail = *aio_ring.sq_tail;
+		for(; idx < nops && queued < aio_ring.entries; idx++)
+		{
+			if(!aio_wants(&ops[idx], stage))
+				continue;
+
+			slot = tail & *aio_ring.sq_mask;
+			if(aio_uring_prep(&aio_ring.sqes[slot], &ops[idx], stage) != 0)
+				continue;
+			aio_ring.sqes[slot].user_data = idx;
+			aio_ring.sq_array[slot] = slot;
+			tail++;
+			queued++;
+		}
+		if(queued == 0)
+			break;
+
+		__atomic_store_n(aio_ring.sq_tail, tail, __ATOMIC_RELEASE);
+		if(aio_uring_wait(ops, stage, queued) != 0)
+			return -1;
+		ran += queued;
+	}
+
+	return ran;
+}
+
+/* runs a step of one file with blocking system calls */
+static void aio_thread_step(aio_op_t *op, aio_stage_e stage)
+{
+	aio_file_t *file = op->file;
+	ssize_t res;
+
+	switch(stage)
+	{
+		case AIO_STAGE_SIZE:
+			res = statx(AT_FDCWD, file->path, 0, STATX_SIZE, &op->stx);
+			break;
+		case AIO_STAGE_OPEN:
+			if(op->is_write)
+				res = open(file->path, O_CLOEXEC | O_WRONLY | O_CREAT | O_TRUNC, 0666);
+			else
+				res = open(file->path, O_CLOEXEC | O_RDONLY);
+			break;
+		case AIO_STAGE_TRANSFER:
+			if(op->is_write)
+				res = pwrite(op->fd, file->data + op->done, file->len - op->done, op->done);
+			else if(aio_read_buffer(op) == 0)
+				res = pread(op->fd, file->data, AIO_READ_SIZE + 1, 0);
+			else
+				return;
+			break;
+		default:
+			res = close(op->fd);
+			break;
+	}
+
+	aio_complete(op, stage, res < 0 ? -errno : (int)res);
+}
+
+/* runs the remaining steps of one file (thread pool work) */
+static void aio_thread_work(void *arg, int worker, int item)
+{
+	aio_op_t *op = &((aio_op_t *)arg)[item];
+	aio_stage_e stage;
+
+	(void)worker;
+	for(stage = AIO_STAGE_SIZE; stage <= AIO_STAGE_CLOSE; stage++)
+	{
+		while(aio_wants(op, stage))
+			aio_thread_step(op, stage);
+	}
+}
+
+/* runs open, transfer and close for a set of files */
+static void aio_run(aio_file_t *files, int nfiles, int is_write)
+{
+	aio_op_t *ops;
+	int idx, ran;
+	aio_stage_e stage;
+
+	if(NULL == (ops = malloc(nfiles * sizeof(aio_op_t))))
+	{
+		for(idx = 0; idx < nfiles; idx++)
+			aio_fail(&files[idx], AIO_STAGE_OPEN, ENOMEM);
+		return;
+	}
+	for(idx = 0; idx < nfiles; idx++)
+	{
+		ops[idx].file = &files[idx];
+		ops[idx].fd = -1;
+		ops[idx].done = 0;
+		ops[idx].is_write = is_write;
+		ops[idx].sized = 0;
+	}
+
+	/* io_uring runs every step for all files at once, a step is repeated
+	 * until no file needs it (short writes)
+	 */
+	for(stage = AIO_STAGE_SIZE; aio_backend == AIO_BACKEND_URING && stage <= AIO_STAGE_CLOSE; stage++)
+	{
+		while((ran = aio_uring_step(ops, nfiles, stage)) > 0)
+			;
+		if(ran < 0)
+			aio_backend = AIO_BACKEND_THREADS; // the ring failed, finish with threads
+	}
+
+	/* the thread pool runs all steps of a file in turn */
+	if(aio_backend != AIO_BACKEND_URING)
+		batch_run(nfiles, AIO_THREADS, aio_thread_work, ops);
+
+	free(ops);
+}
+
+/************ Batched I/O functions **********/
+
+/* Sets up the requested backend. io_uring falls back to the thread pool if
+ * the kernel does not support it. Returns the backend in use.
+ */
+aio_backend_e aio_start(aio_backend_e backend)
+{
+	if(backend == AIO_BACKEND_URING && aio_backend != AIO_BACKEND_URING && aio_ring_setup() != 0)
+		backend = AIO_BACKEND_THREADS;
+	aio_backend = backend;
+
+	return aio_backend;
+}
+
+/* Returns the name of a backend. */
+const char *aio_backend_name(aio_backend_e backend)
+{
+	switch(backend)
+	{
+		case AIO_BACKEND_URING:
+			return "io_uring";
+		case AIO_BACKEND_THREADS:
+			return "threads";
+		default:
+			return "none";
+	}
+}
+
+/* Reads every file of up to AIO_READ_SIZE bytes into a malloc'ed buffer
+ * (data, len). Larger files fail with EFBIG and are left to the caller,
+ * without having been opened or read.
+ */
+void aio_read_files(aio_file_t *files, int nfiles)
+{
+	int idx;
+
+	for(idx = 0; idx < nfiles; idx++)
+	{
+		files[idx].data = NULL;
+		files[idx].len = 0;
+		files[idx].error = 0;
+	}
+
+	aio_run(files, nfiles, 0);
+}
+
+/* Creates (or truncates) every file and writes its data. */
+void aio_write_files(aio_file_t *files, int nfiles)
+{
+	int idx;
+
+	for(idx = 0; idx < nfiles; idx++)
+		files[idx].error = 0;
+
+	aio_run(files, nfiles, 1);
+}
+
+/**** End of file ****/
@@ -0,0 +1,66 @@
+/*
+ * Header for batched file I/O of small files.
+ *
+ * Batch conversions of trees with many small files spend most of their time
+ * in open/read/write/close system calls. These functions run one step (size,
+ * open, read or write, close) for a whole set of files at once: with io_uring every
+ * step is a single submission for up to AIO_RING_DEPTH files; on kernels
+ * without it a pool of threads runs the plain system calls in parallel.
+ *
+ * Constants:
+ * - AIO_READ_SIZE: Largest file read by aio_read_files.
+ * - AIO_RING_DEPTH: Operations submitted to io_uring at a time.
+ *
+ * Enum (aio_backend_e):
+ * - The I/O backends.
+ *
+ * Structure (aio_file_t):
+ * - A file to read or write, with the step which failed.
+ *
+ * Functions:
+ * - aio_start: Sets up a backend (falls back to threads without io_uring).
+ * - aio_backend_name: Name of a backend.
+ * - aio_read_files / aio_write_files: Read or write a set of files.
+ */
+
+#ifndef S2HTML_AIO_H
+#define S2HTML_AIO_H
+
+#include <stddef.h>
+
+#define AIO_READ_SIZE	(32 * 1024)
+#define AIO_RING_DEPTH	256
+
+typedef enum
+{
+	AIO_BACKEND_NONE,     // no batched I/O, files are read and written by the converter
+	AIO_BACKEND_URING,    // io_uring
+	AIO_BACKEND_THREADS   // thread pool running blocking system calls
+} aio_backend_e;
+
+typedef enum
+{
+	AIO_STAGE_SIZE,       // read: size check, larger files are not opened
+	AIO_STAGE_OPEN,
+	AIO_STAGE_TRANSFER,   // read or write
+	AIO_STAGE_CLOSE
+} aio_stage_e;
+
+typedef struct
+{
+	const char *path;
+	char *data;           // read: contents (malloc'ed, free after use), write: bytes to write
+	size_t len;
+	int error;            // 0 or errno of the failed step, EFBIG if larger than AIO_READ_SIZE
+	aio_stage_e stage;    // failed step
+} aio_file_t;
+
+/********** function prototypes **********/
+
+aio_backend_e aio_start(aio_backend_e backend);
+const char *aio_backend_name(aio_backend_e backend);
+void aio_read_files(aio_file_t *files, int nfiles);
+void aio_write_files(aio_file_t *files, int nfiles);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,224 @@
+/*
+ * Arena Allocator Functions
+ *
+ * This file implements a chunked bump allocator used for memory which lives
+ * exactly as long as the conversion of one file. Each size class bumps
+ * through its own list of chunks; a reset rewinds all chunks instead of
+ * freeing them, so steady state conversions do not call malloc at all.
+ *
+ * Main features:
+ * - arena_alloc / arena_strndup: Bump allocation per size class.
+ * - arena_reset: Frees all allocations of a file in one step.
+ * - arena_acquire / arena_release: Arenas pooled per worker thread, the pool
+ *   of a thread is drained when the thread exits.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "s2html_arena.h"
+
+/* one malloc'ed block of memory bumped by a size class */
+typedef struct arena_chunk
+{
+	struct arena_chunk *next;
+	size_t size;              // usable bytes in data
+	size_t used;              // bytes handed out so far
+	max_align_t data[];       // memory handed out
+} arena_chunk_t;
+
+/* chunk list of one size class */
+typedef struct
+{
+	arena_chunk_t *first;     // all chunks of the class
+	arena_chunk_t *cur;       // chunk currently bumped
+} arena_list_t;
+
+struct arena
+{
+	arena_list_t list[ARENA_CLASS_COUNT];
+	arena_t *next_free;       // link in the per thread pool
+};
+
+/* arenas released by this thread, ready for reuse */
+static __thread arena_t *arena_pool = NULL;
+
+/* key whose destructor drains the pool of an exiting thread */
+static pthread_key_t arena_pool_key;
+static pthread_once_t arena_pool_once = PTHREAD_ONCE_INIT;
+
+/********** Utility functions **********/
+
+/* allocates a new chunk with at least 'size' usable bytes */
+static arena_chunk_t *arena_new_chunk(size_t size)
+{
+	arena_chunk_t *chunk;
+
+	if(size < ARENA_CHUNK_SIZE)
+		size = ARENA_CHUNK_SIZE;
+	if(NULL == (chunk = malloc(sizeof(arena_chunk_t) + size)))
+		return NULL;
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+
+	return chunk;
+}
+
+/************ Arena functions **********/
+
+/* Creates an empty arena, chunks are allocated on first use. */
+arena_t *arena_create(void)
+{
+	return calloc(1, sizeof(arena_t));
+}
+
+/* Frees an arena and all of its chunks. */
+void arena_destroy(arena_t *arena)
+{
+	arena_chunk_t *chunk, *next;
+	int cls;
+
+	if(arena == NULL)
+		return;
+
+	for(cls = 0; cls < ARENA_CLASS_COUNT; cls++)
+	{
+		for(chunk = arena->list[cls].first; chunk != NULL; chunk = next)
+		{
+			next = chunk->next;
+			free(chunk);
+		}
+	}
+	free(arena);
+}
+
+/* Returns 'size' bytes of the given size class, records are aligned for any
+ * type. The memory stays valid until the arena is reset or destroyed.
+ * Returns NULL only if a new chunk could not be allocated.
+ */
+void *arena_alloc(arena_t *arena, arena_class_e cls, size_t size)
+{
+	arena_list_t *list = &arena->list[cls];
+	arena_chunk_t *chunk = list->cur;
+	void *ptr;
+
+	if(cls == ARENA_CLASS_RECORD)
+		size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+
+	/* move on to the next (rewound) chunk, or add a new one behind the current */
+	while(chunk == NULL || chunk->size - chunk->used < size)
+	{
+		if(chunk != NULL && chunk->next != NULL)
+		{
+			chunk = chunk->next;
+			continue;
+		}
+
+		arena_chunk_t *new_chunk = arena_new_chunk(size);
+		if(new_chunk == NULL)
+			return NULL;
+		if(chunk == NULL)
+			list->first = new_chunk;
+		else
+			chunk->next = new_chunk;
+		chunk = new_chunk;
+	}
+
+	list->cur = chunk;
+	ptr = (char *)chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+/* Copies 'len' bytes of 'str' into the arena and null-terminates the copy. */
+char *arena_strndup(arena_t *arena, const char *str, size_t len)
+{
+	char *copy;
+
+	if(NULL == (copy = arena_alloc(arena, ARENA_CLASS_TEXT, len + 1)))
+		return NULL;
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+
+	return copy;
+}
+
+/* Releases all allocations at once, the chunks are kept for reuse. */
+void arena_reset(arena_t *arena)
+{
+	arena_chunk_t *chunk;
+	int cls;
+
+	for(cls = 0; cls < ARENA_CLASS_COUNT; cls++)
+	{
+		for(chunk = arena->list[cls].first; chunk != NULL; chunk = chunk->next)
+			chunk->used = 0;
+		arena->list[cls].cur = arena->list[cls].first;
+	}
+}
+
+/********** Per thread pool **********/
+
+/* thread exit: frees the arenas pooled by the thread */
+static void arena_pool_exit(void *unused)
+{
+	(void)unused;
+	arena_pool_drain();
+}
+
+/* creates the key draining pools on thread exit, once per process */
+static void arena_pool_key_create(void)
+{
+	pthread_key_create(&arena_pool_key, arena_pool_exit);
+}
+
+/* Returns an empty arena, reusing one released earlier by this thread. */
+arena_t *arena_acquire(void)
+{
+	arena_t *arena = arena_pool;
+
+	if(arena == NULL)
+		return arena_create();
+
+	arena_pool = arena->next_free;
+	arena->next_free = NULL;
+
+	return arena;
+}
+
+/* Resets an arena and keeps it in this thread's pool. */
+void arena_release(arena_t *arena)
+{
+	if(arena == NULL)
+		return;
+
+	arena_reset(arena);
+
+	/* the thread's first pooled arena: drain the pool when the thread exits
+	 * (the key's value only needs to be non NULL for its destructor to run)
+	 */
+	if(arena_pool == NULL)
+	{
+		pthread_once(&arena_pool_once, arena_pool_key_create);
+		pthread_setspecific(arena_pool_key, &arena_pool_key);
+	}
+
+	arena->next_free = arena_pool;
+	arena_pool = arena;
+}
+
+/* Frees all pooled arenas of this thread, done by itself when the thread exits. */
+void arena_pool_drain(void)
+{
+	arena_t *arena;
+
+	while((arena = arena_pool) != NULL)
+	{
+		arena_pool = arena->next_free;
+		arena_destroy(arena);
+	}
+}
+
+/**** End of file ****/
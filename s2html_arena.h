@@ -0,0 +1,52 @@
+/*
+ * Header for the per-conversion arena (bump) allocator.
+ *
+ * Everything allocated while converting one file (stored tokens and their
+ * text) comes from an arena and is released at once by resetting it when the
+ * file is done. Memory is kept across resets, so after the first file no
+ * malloc happens in the hot path. Arenas are pooled per thread.
+ *
+ * Constants:
+ * - ARENA_CHUNK_SIZE: Size of one memory chunk requested from malloc.
+ *
+ * Enum (arena_class_e):
+ * - Size classes, each bumped in its own chunks so records stay densely packed.
+ *
+ * Functions:
+ * - arena_create / arena_destroy: Allocates and frees an arena.
+ * - arena_alloc: Bump allocates memory of a size class.
+ * - arena_strndup: Copies token text into the arena.
+ * - arena_reset: Releases everything allocated, keeping the memory for reuse.
+ * - arena_acquire / arena_release / arena_pool_drain: Per thread arena pool (drained on thread exit).
+ */
+
+#ifndef S2HTML_ARENA_H
+#define S2HTML_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+
+typedef enum
+{
+	ARENA_CLASS_RECORD,   // fixed size, aligned records (stored events)
+	ARENA_CLASS_TEXT,     // unaligned token text
+	ARENA_CLASS_COUNT
+} arena_class_e;
+
+typedef struct arena arena_t;
+
+/********** function prototypes **********/
+
+arena_t *arena_create(void);
+void arena_destroy(arena_t *arena);
+void *arena_alloc(arena_t *arena, arena_class_e cls, size_t size);
+char *arena_strndup(arena_t *arena, const char *str, size_t len);
+void arena_reset(arena_t *arena);
+
+arena_t *arena_acquire(void);
+void arena_release(arena_t *arena);
+void arena_pool_drain(void);
+
+#endif
+/**** End of file ****/
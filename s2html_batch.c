@@ -0,0 +1,231 @@
+/*
+ * Batch Processing Functions
+ *
+ * This file runs a work function over many items using worker threads.
+ * Items are handed out one at a time through an atomic counter, the calling
+ * thread takes part as worker 0. A pool parks its threads on a condition
+ * variable between batches instead of ending them.
+ *
+ * Main features:
+ * - batch_workers: Number of workers to use by default.
+ * - batch_run: Runs the work function for every item.
+ * - batch_pool_create / batch_pool_run / batch_pool_destroy: The same on kept threads.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "s2html_batch.h"
+
+/* state shared by the workers of one batch */
+typedef struct
+{
+    batch_work_fn work;
+    void *arg;
+    int items;
+    int next_item;      // next item to hand out, taken atomically
+} batch_t;
+
+/* arguments of one worker thread */
+typedef struct
+{
+    batch_t *batch;
+    batch_pool_t *pool;     // pool of the thread, NULL for batch_run
+    int worker;
+} batch_worker_t;
+
+/* threads kept between batches */
+struct batch_pool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t start;   // a batch was posted or the pool stops
+    pthread_cond_t done;    // the last pool thread finished the batch
+    pthread_t tid[BATCH_MAX_WORKERS];
+    batch_worker_t self[BATCH_MAX_WORKERS];
+    batch_t batch;          // the batch being run
+    int workers;            // started threads plus the caller
+    int generation;         // batches posted so far
+    int busy;               // pool threads still working on the batch
+    int stop;
+};
+
+/* takes items until none are left */
+static void *batch_worker(void *arg)
+{
+    batch_worker_t *self = arg;
+    batch_t *batch = self->batch;
+    int item;
+
+    while ((item = __atomic_fetch_add(&batch->next_item, 1, __ATOMIC_RELAXED)) < batch->items)
+        batch->work(batch->arg, self->worker, item);
+
+    return NULL;
+}
+
+/* pool thread: runs every posted batch until the pool stops */
+static void *batch_pool_worker(void *arg)
+{
+    batch_worker_t *self = arg;
+    batch_pool_t *pool = self->pool;
+    int seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        batch_worker(self);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Returns the number of online CPUs, limited to BATCH_MAX_WORKERS. */
+int batch_workers(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus < 1)
+        return 1;
+
+    return cpus > BATCH_MAX_WORKERS ? BATCH_MAX_WORKERS : (int)cpus;
+}
+
+/* Runs work(arg, worker, item) for every item in [0, items) on up to
+ * 'workers' threads. Worker indexes are below 'workers', so callers can keep
+ * per worker state in an array. Returns the number of workers used.
+ */
+int batch_run(int items, int workers, batch_work_fn work, void *arg)
+{
+    pthread_t tid[BATCH_MAX_WORKERS];
+    batch_worker_t self[BATCH_MAX_WORKERS];
+    batch_t batch = { work, arg, items, 0 };
+    int idx, started;
+
+    if (workers > items)
+        workers = items;
+    if (workers > BATCH_MAX_WORKERS)
+        workers = BATCH_MAX_WORKERS;
+    if (workers < 1)
+        workers = 1;
+
+    for (idx = 0; idx < workers; idx++)
+    {
+        self[idx].batch = &batch;
+        self[idx].pool = NULL;
+        self[idx].worker = idx;
+    }
+
+    /* workers which could not be started are simply covered by the others */
+    for (started = 1; started < workers; started++)
+    {
+        if (pthread_create(&tid[started], NULL, batch_worker, &self[started]) != 0)
+            break;
+    }
+
+    batch_worker(&self[0]);
+
+    for (idx = 1; idx < started; idx++)
+        pthread_join(tid[idx], NULL);
+
+    return workers;
+}
+
+/* Starts a pool of up to 'workers' workers, the thread calling
+ * batch_pool_run() is one of them. Returns NULL if out of memory.
+ */
+batch_pool_t *batch_pool_create(int workers)
+{
+    batch_pool_t *pool;
+
+    if (NULL == (pool = calloc(1, sizeof(batch_pool_t))))
+        return NULL;
+
+    if (workers > BATCH_MAX_WORKERS)
+        workers = BATCH_MAX_WORKERS;
+    if (workers < 1)
+        workers = 1;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    /* as in batch_run, the pool simply gets smaller if a thread fails to start */
+    for (pool->workers = 0; pool->workers < workers; pool->workers++)
+    {
+        batch_worker_t *self = &pool->self[pool->workers];
+
+        self->batch = &pool->batch;
+        self->pool = pool;
+        self->worker = pool->workers;
+        if (pool->workers > 0 &&
+            pthread_create(&pool->tid[pool->workers], NULL, batch_pool_worker, self) != 0)
+            break;
+    }
+
+    return pool;
+}
+
+/* Runs work(arg, worker, item) for every item in [0, items) on the threads
+ * of the pool and returns when all are done. Without a pool a batch_run()
+ * over batch_workers() threads is done instead. Returns the number of
+ * workers, worker indexes are below it.
+ */
+int batch_pool_run(batch_pool_t *pool, int items, batch_work_fn work, void *arg)
+{
+    if (pool == NULL)
+        return batch_run(items, batch_workers(), work, arg);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->batch.work = work;
+    pool->batch.arg = arg;
+    pool->batch.items = items;
+    pool->batch.next_item = 0;
+    pool->busy = pool->workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    batch_worker(&pool->self[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    return pool->workers;
+}
+
+/* Stops the threads of a pool and frees it. */
+void batch_pool_destroy(batch_pool_t *pool)
+{
+    int idx;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (idx = 1; idx < pool->workers; idx++)
+        pthread_join(pool->tid[idx], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+/**** End of file ****/
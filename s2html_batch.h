@@ -0,0 +1,39 @@
+/*
+ * Header for running work over many files in parallel.
+ *
+ * A batch is a number of items (usually files) processed by a small set of
+ * worker threads. Each worker repeatedly takes the next unprocessed item,
+ * so large and small files balance out automatically.
+ *
+ * A pool keeps its worker threads between batches, for callers which run
+ * many small batches (e.g. watch mode, one batch per burst of changes).
+ *
+ * Types:
+ * - batch_work_fn: Called once per item with the index of the worker running it.
+ * - batch_pool_t: Worker threads kept for several batches.
+ *
+ * Functions:
+ * - batch_workers: Default number of worker threads (online CPUs).
+ * - batch_run: Processes all items and returns when every item is done.
+ * - batch_pool_create / batch_pool_destroy: Start and stop the threads of a pool.
+ * - batch_pool_run: Like batch_run, on the threads of a pool.
+ */
+
+#ifndef S2HTML_BATCH_H
+#define S2HTML_BATCH_H
+
+#define BATCH_MAX_WORKERS	64
+
+typedef void (*batch_work_fn)(void *arg, int worker, int item);
+typedef struct batch_pool batch_pool_t;
+
+/********** function prototypes **********/
+
+int batch_workers(void);
+int batch_run(int items, int workers, batch_work_fn work, void *arg);
+batch_pool_t *batch_pool_create(int workers);
+int batch_pool_run(batch_pool_t *pool, int items, batch_work_fn work, void *arg);
+void batch_pool_destroy(batch_pool_t *pool);
+
+#endif
+/**** End of file ****/
@@ -5,90 +5,355 @@
  * It includes functions to:
  * 1. `html_begin`: Adds the opening HTML tags.
  * 2. `html_end`: Adds the closing HTML tags.
- * 3. `source_to_html`: Converts source code elements into HTML with styling.
+ * 3. `source_to_html` / `source_to_html_tokens`: Converts source code elements (single events
+ *    or a stored token stream) into HTML with styling.
+ * 4. `html_set_compact` / `html_is_compact` / `html_write_styles`: Compact output mode, which merges adjacent
+ *    runs of the same class into one span, uses short generated class names and drops
+ *    optional markup. Its stylesheet is generated from the same class table.
+ * 5. `html_set_theme`: Selects the theme of regular output. Its page and token markup are
+ *    prebuilt fragments (see s2html_theme.h), so a token is rendered by indexing a table.
+ * 6. Inactive conditional regions (PEVENT_INACTIVE_REGION) are written as one collapsed
+ *    <details> block without token markup inside, however many events they span.
+ * 7. All source text is HTML escaped ('<', '>' and '&'), so it never becomes markup.
+ * 8. The output (html_out_t) is a stream, or a memory area the markup is copied to
+ *    directly, e.g. the mapping of the output file (see s2html_mapout.h).
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "s2html_event.h"
+#include "s2html_theme.h"
 #include "s2html_conv.h"
 
-/* html_begin function definition */
+/* highlighting classes, in the order of the class table below */
+typedef enum
+{
+    HCLASS_NONE,
+    HCLASS_PREPROCESS_DIR,
+    HCLASS_COMMENT,
+    HCLASS_STRING,
+    HCLASS_HEADER_FILE,
+    HCLASS_NUMERIC_CONSTANT,
+    HCLASS_RESERVED_KEY1,
+    HCLASS_RESERVED_KEY2,
+    HCLASS_ASCII_CHAR,
+    HCLASS_INACTIVE,
+    HCLASS_COUNT
+} hclass_e;
 
-/* Writes the beginning HTML structure to the file (DOCTYPE, HTML, HEAD, BODY tags). */
-void html_begin(FILE *dest_fp, int type) /* type => not used, but can be used to add different HTML tags */
-{
-    fprintf(dest_fp, "<!DOCTYPE html>\n");
-    fprintf(dest_fp, "<html lang=\"en-US\">\n");
-    fprintf(dest_fp, "<head>\n");
-    fprintf(dest_fp, "<title>%s</title>\n", "sode2html");
-    fprintf(dest_fp, "<meta charset=\"UTF-8\">\n");
-    fprintf(dest_fp, "<link rel=\"stylesheet\" href=\"styles.css\">\n");
-    fprintf(dest_fp, "</head>\n");
-    fprintf(dest_fp, "<body style=\"background-color:lightgrey;\">\n");
-    fprintf(dest_fp, "<pre>\n");
-}
+/* class name and style of every highlighting class (must match styles.css),
+ * the short compact class name is generated from the table index
+ */
+static const struct
+{
+    const char *name;
+    const char *style;
+} html_classes[HCLASS_COUNT] = {
+    [HCLASS_NONE]             = { "",                 "" },
+    [HCLASS_PREPROCESS_DIR]   = { "preprocess_dir",   "color:purple" },
+    [HCLASS_COMMENT]          = { "comment",          "color:blue" },
+    [HCLASS_STRING]           = { "string",           "color:magenta" },
+    [HCLASS_HEADER_FILE]      = { "header_file",      "color:red" },
+    [HCLASS_NUMERIC_CONSTANT] = { "numeric_constant", "color:brown" },
+    [HCLASS_RESERVED_KEY1]    = { "reserved_key1",    "color:green" },
+    [HCLASS_RESERVED_KEY2]    = { "reserved_key2",    "color:goldenrod" },
+    [HCLASS_ASCII_CHAR]       = { "ascii_char",       "color:firebrick" },
+    [HCLASS_INACTIVE]         = { "inactive",         "color:gray" },
+};
 
-/* html_end function definition */
+/* compact output mode and the class of the span currently left open in it
+ * (per thread, each thread converts its own file)
+ */
+static int html_compact = 0;
+static __thread hclass_e open_class = HCLASS_NONE;
+
+/* an inactive region block is open, consecutive region events share it */
+static __thread int inactive_open = 0;
+
+/* theme of regular output, read only while converting */
+static const theme_t *html_theme = &theme_default;
 
-/* Writes the closing HTML tags to the file (BODY, HTML). */
-void html_end(FILE *dest_fp, int type) /* type => not used, but can be used to add different HTML tags */
+/* short class name of a highlighting class in compact mode */
+#define HCLASS_SHORT_NAME(c)	((char)('a' + (c) - 1))
+
+/* html_put function definition */
+
+/* Copies 'len' bytes to the output: to its stream, or straight into its
+ * memory area, which is grown when full.
+ */
+static inline void html_put(html_out_t *out, const char *data, size_t len)
 {
-    fprintf(dest_fp, "</pre>\n");
-    fprintf(dest_fp, "</body>\n");
-    fprintf(dest_fp, "</html>\n");
+    if (out->fp != NULL)
+    {
+        fwrite(data, 1, len, out->fp);
+        return;
+    }
+
+    if ((size_t)(out->end - out->pos) < len && (out->error || out->grow(out, len) != 0))
+    {
+        out->error = 1;
+        return;
+    }
+    memcpy(out->pos, data, len);
+    out->pos += len;
 }
 
+#define html_puts(out, text)	html_put(out, text, strlen(text))
 
-/* source_to_html function definition */
+/* html_put_class function definition */
 
-/* Converts event data into HTML format and writes it to the file. */
-void source_to_html(FILE *fp, pevent_t *event)
+/* Writes markup with the short class name 'cls' in place of its '%' (compact mode). */
+static void html_put_class(html_out_t *out, const char *markup, hclass_e cls)
 {
-#ifdef DEBUG
-    printf("%s", event->data);  // Debug output to console
-#endif
+    const char *at = strchr(markup, '%');
+    char name = HCLASS_SHORT_NAME(cls);
 
-    switch(event->type)
+    html_put(out, markup, at - markup);
+    html_put(out, &name, 1);
+    html_puts(out, at + 1);
+}
+
+/* maps an event to its highlighting class, HCLASS_COUNT for unknown events */
+static hclass_e html_class_of(pevent_e type, int property)
+{
+    switch(type)
     {
         case PEVENT_PREPROCESSOR_DIRECTIVE:
-            fprintf(fp,"<span class=\"preprocess_dir\">%s</span>", event->data);
-            break;
+            return HCLASS_PREPROCESS_DIR;
         case PEVENT_MULTI_LINE_COMMENT:
         case PEVENT_SINGLE_LINE_COMMENT:
-            fprintf(fp,"<span class=\"comment\">%s</span>", event->data);
-            break;
+            return HCLASS_COMMENT;
         case PEVENT_STRING:
-            fprintf(fp,"<span class=\"string\">%s</span>", event->data);
-            break;
+            return HCLASS_STRING;
         case PEVENT_HEADER_FILE:
-            if(event->property == USER_HEADER_FILE)
-                fprintf(fp,"<span class=\"header_file\">%s</span>", event->data);
-            else
-                fprintf(fp,"<span class=\"header_file\">&lt;%s&gt;</span>", event->data);
-            break;
+            return HCLASS_HEADER_FILE;
         case PEVENT_REGULAR_EXP:
         case PEVENT_EOF:
-            fprintf(fp,"%s", event->data);
-            break;
+            return HCLASS_NONE;
         case PEVENT_NUMERIC_CONSTANT:
-            fprintf(fp,"<span class=\"numeric_constant\">%s</span>", event->data);
-            break;
+            return HCLASS_NUMERIC_CONSTANT;
         case PEVENT_RESERVE_KEYWORD:
-            if(event->property == RES_KEYWORD_DATA)
-            {
-                fprintf(fp,"<span class=\"reserved_key1\">%s</span>", event->data);
-            }
-            else
-            {
-                fprintf(fp,"<span class=\"reserved_key2\">%s</span>", event->data);
-            }
-            break;
+            return (property == RES_KEYWORD_DATA) ? HCLASS_RESERVED_KEY1 : HCLASS_RESERVED_KEY2;
         case PEVENT_ASCII_CHAR:
-            fprintf(fp,"<span class=\"ascii_char\">%s</span>", event->data);
-            break;
+            return HCLASS_ASCII_CHAR;
+        case PEVENT_INACTIVE_REGION:
+            return HCLASS_INACTIVE;
         default:
-            printf("Unknown event\n");
-            break;
+            return HCLASS_COUNT;
     }
 }
 
+/* html_set_compact function definition */
+
+/* Selects compact (non zero) or regular output for the following conversions. */
+void html_set_compact(int compact)
+{
+    html_compact = compact;
+}
+
+/* html_is_compact function definition */
+
+/* Returns non zero if compact output is selected. */
+int html_is_compact(void)
+{
+    return html_compact;
+}
+
+/* html_set_theme function definition */
+
+/* Selects the theme of regular output for the following conversions. */
+void html_set_theme(const theme_t *theme)
+{
+    html_theme = theme;
+}
+
+/* html_write_styles function definition */
+
+/* Writes the stylesheet matching the short class names of compact mode. */
+void html_write_styles(FILE *css_fp)
+{
+    int cls;
+
+    fprintf(css_fp, "body{background-color:lightgrey}");
+    for (cls = HCLASS_NONE + 1; cls < HCLASS_COUNT; cls++)
+        fprintf(css_fp, ".%c{%s}", HCLASS_SHORT_NAME(cls), html_classes[cls].style);
+    fprintf(css_fp, "\n");
+}
+
+/* html_begin function definition */
+
+/* Writes the beginning HTML structure to the output (DOCTYPE, HTML, HEAD, BODY tags). */
+void html_begin(html_out_t *out, int type) /* type => not used, but can be used to add different HTML tags */
+{
+    (void)type;
+    open_class = HCLASS_NONE;
+    inactive_open = 0;
+    if (html_compact)
+    {
+        /* head and body tags are optional, the background moves to the stylesheet */
+        html_puts(out, "<!DOCTYPE html><html lang=en-US><meta charset=UTF-8>"
+                       "<title>source2html</title><link rel=stylesheet href=" HTML_COMPACT_STYLES "><pre>\n");
+        return;
+    }
+
+    html_put(out, html_theme->begin.text, html_theme->begin.len);
+}
+
+/* html_inactive_block function definition */
+
+/* Opens or closes the collapsed block of an inactive region (a <details> element,
+ * expanded on demand), the region text inside gets no token markup.
+ */
+static void html_inactive_block(html_out_t *out, int open)
+{
+    const theme_frag_t *frag;
+
+    if (html_compact)
+    {
+        /* spans cannot cross the block */
+        if (open_class != HCLASS_NONE)
+            html_puts(out, "</span>");
+        open_class = HCLASS_NONE;
+        if (open)
+            html_put_class(out, "<details class=%><summary>inactive</summary>", HCLASS_INACTIVE);
+        else
+            html_puts(out, "</details>");
+    }
+    else
+    {
+        frag = open ? &html_theme->open[PEVENT_INACTIVE_REGION][0] : &html_theme->close[PEVENT_INACTIVE_REGION][0];
+        html_put(out, frag->text, frag->len);
+    }
+
+    inactive_open = open;
+}
+
+/* html_end function definition */
+
+/* Writes the closing HTML tags to the output (BODY, HTML). */
+void html_end(html_out_t *out, int type) /* type => not used, but can be used to add different HTML tags */
+{
+    (void)type;
+    if (inactive_open)
+        html_inactive_block(out, 0);
+
+    if (html_compact)
+    {
+        /* close the last merged span, closing body and html tags are optional */
+        if (open_class != HCLASS_NONE)
+            html_puts(out, "</span>");
+        html_puts(out, "</pre>\n");
+        open_class = HCLASS_NONE;
+        return;
+    }
+
+    html_put(out, html_theme->end.text, html_theme->end.len);
+}
+
+
+/* html_escape function definition */
+
+/* Writes text with '<', '>' and '&' escaped, so that it cannot become markup. */
+static void html_escape(html_out_t *out, const char *data)
+{
+    size_t len;
+
+    while (data[len = strcspn(data, "<>&")] != '\0')
+    {
+        html_put(out, data, len);
+        html_puts(out, data[len] == '<' ? "&lt;" : data[len] == '>' ? "&gt;" : "&amp;");
+        data += len + 1;
+    }
+    html_put(out, data, len);
+}
+
+/* html_emit_compact function definition */
+
+/* Converts event data in compact mode, a span is only switched when the class changes. */
+static void html_emit_compact(html_out_t *out, pevent_e type, int property, const char *data)
+{
+    hclass_e cls = html_class_of(type, property);
+
+    if (cls == HCLASS_COUNT)
+    {
+        printf("Unknown event\n");
+        return;
+    }
+
+    /* whitespace looks the same in any class, keep it inside the open span */
+    if (cls == HCLASS_NONE && data[strspn(data, " \t\r\n")] == '\0')
+        cls = open_class;
+
+    if (cls != open_class)
+    {
+        if (open_class != HCLASS_NONE)
+            html_puts(out, "</span>");
+        if (cls != HCLASS_NONE)
+            html_put_class(out, "<span class=%>", cls);
+        open_class = cls;
+    }
+
+    if (type == PEVENT_HEADER_FILE && property != USER_HEADER_FILE)
+        html_puts(out, "&lt;");
+    html_escape(out, data);
+    if (type == PEVENT_HEADER_FILE && property != USER_HEADER_FILE)
+        html_puts(out, "&gt;");
+}
+
+/* html_emit function definition */
+
+/* Writes the HTML of one event (given by its fields) to the output. */
+static void html_emit(html_out_t *out, pevent_e type, int property, const char *data)
+{
+    const theme_frag_t *frag;
+    int slot;
+
+#ifdef DEBUG
+    printf("%s", data);  // Debug output to console
+#endif
+
+    /* the chunks of an inactive region are written into one block */
+    if ((type == PEVENT_INACTIVE_REGION) != inactive_open)
+        html_inactive_block(out, !inactive_open);
+    if (type == PEVENT_INACTIVE_REGION)
+    {
+        html_escape(out, data);
+        return;
+    }
+
+    if (html_compact)
+    {
+        html_emit_compact(out, type, property, data);
+        return;
+    }
+
+    if (type <= PEVENT_NULL || type > PEVENT_EOF)
+    {
+        printf("Unknown event\n");
+        return;
+    }
+
+    slot = THEME_SLOT(property);
+    frag = &html_theme->open[type][slot];
+    html_put(out, frag->text, frag->len);
+    html_escape(out, data);
+    frag = &html_theme->close[type][slot];
+    html_put(out, frag->text, frag->len);
+}
+
+/* source_to_html function definition */
+
+/* Converts event data into HTML format and writes it to the output. */
+void source_to_html(html_out_t *out, pevent_t *event)
+{
+    html_emit(out, event->type, event->property, event->data);
+}
+
+/* source_to_html_tokens function definition */
+
+/* Converts a stored token stream (see get_parser_tokens) and writes it to the output. */
+void source_to_html_tokens(html_out_t *out, ptoken_t *tokens)
+{
+    for (; tokens != NULL; tokens = tokens->next)
+        html_emit(out, tokens->type, tokens->property, tokens->data);
+}
@@ -4,11 +4,21 @@
  * Constants:
  * - HTML_OPEN: Marks opening HTML tags.
  * - HTML_CLOSE: Marks closing HTML tags.
+ * - HTML_COMPACT_STYLES: Stylesheet generated for and linked by compact output.
+ *
+ * Structure (html_out_t):
+ * - Destination of the rendered HTML: a stream, or a memory area written
+ *   directly and grown by its owner when full (e.g. a mapped output file).
  *
  * Functions:
  * - html_begin: Adds opening HTML tags.
  * - html_end: Adds closing HTML tags.
  * - source_to_html: Converts source code to HTML and writes it.
+ * - source_to_html_tokens: Converts a stored token stream to HTML and writes it.
+ * - html_set_compact: Selects compact output (merged spans, short class names).
+ * - html_is_compact: Tells whether compact output is selected.
+ * - html_write_styles: Writes the stylesheet used by compact output.
+ * - html_set_theme: Selects the theme (page and token markup) of regular output.
 */
 
 #ifndef S2HTML_CONV_H
@@ -17,11 +27,27 @@
 #define HTML_OPEN	1
 #define HTML_CLOSE	0
 
+#define HTML_COMPACT_STYLES	"styles.min.css"
+
+typedef struct html_out
+{
+    FILE *fp;               // stream, NULL when writing into the memory area
+    char *pos;              // next byte of the memory area
+    char *end;              // end of the memory area
+    int (*grow)(struct html_out *out, size_t need); // makes room for 'need' more bytes, -1 if it cannot
+    int error;              // the memory area could not be grown, the output is incomplete
+} html_out_t;
+
 /********** function prototypes **********/
 
-void html_begin(FILE *dest_fp, int type); // Adds the opening HTML tags to the file.
-void html_end(FILE *dest_fp, int type);   // Adds the closing HTML tags to the file.
-void source_to_html(FILE *fp, pevent_t *event); // Converts source code events to HTML format and writes to the file.
+void html_begin(html_out_t *out, int type); // Adds the opening HTML tags to the output.
+void html_end(html_out_t *out, int type);   // Adds the closing HTML tags to the output.
+void source_to_html(html_out_t *out, pevent_t *event); // Converts source code events to HTML format and writes to the output.
+void source_to_html_tokens(html_out_t *out, ptoken_t *tokens); // Converts a stored token stream to HTML format and writes to the output.
+void html_set_compact(int compact);       // Selects compact (non zero) or regular output.
+int html_is_compact(void);                // Returns non zero if compact output is selected.
+void html_write_styles(FILE *css_fp);     // Writes the stylesheet for the short class names of compact output.
+void html_set_theme(const theme_t *theme); // Selects the theme of regular output.
 
 #endif
 
@@ -1,19 +1,28 @@
 /*
  *  Event Management for Source-to-HTML Analyzer Function
  *
- * This program analyzes a C source code file to identify keywords, comments, 
+ * This program analyzes a source code file to identify keywords, comments, 
  * constants, operators, and strings. It processes the file character by 
- * character and generates events for each identified element.
+ * character and generates events for each identified element. Keywords,
+ * comment delimiters and character classes come from the language definition
+ * of the file (see s2html_lang.h).
  *
  * Main features:
- * - Identifies comments, keywords, constants, strings, and operators.
+ * - Identifies comments, keywords, constants, strings, and operators. A word or
+ *   number read together with the text before it is handed out right after that
+ *   text (kept in word[]), so every keyword becomes its own event.
+ * - Tracks preprocessor conditionals against the macros of add_parser_macro and
+ *   the file's own #define / #undef. Branches which are not compiled are handed
+ *   out as raw PEVENT_INACTIVE_REGION text, no tokens are lexed inside them.
 */
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include "s2html_event.h"
+#include "s2html_utf8.h"
 
 #define SIZE_OF_SYMBOLS (sizeof(symbols))
 #define SIZE_OF_OPERATORS (sizeof(operators))
@@ -33,35 +42,131 @@ typedef enum
 	PSTATE_STRING,
 	PSTATE_SINGLE_LINE_COMMENT,
 	PSTATE_MULTI_LINE_COMMENT,
-	PSTATE_ASCII_CHAR
+	PSTATE_ASCII_CHAR,
+	PSTATE_INACTIVE_REGION,
+	PSTATE_RAW_STRING,
+	PSTATE_DIRECTIVE_LINE
 }pstate_e;
 
 /********** global variables **********/
 
+/* parser state is kept per thread, so several files can be parsed in parallel */
+
 /* parser state variable */
-static pstate_e state = PSTATE_IDLE;
+static __thread pstate_e state = PSTATE_IDLE;
 
 /* sub state is used only in preprocessor state */
-static pstate_e state_sub = PSTATE_SUB_PREPROCESSOR_MAIN;
+static __thread pstate_e state_sub = PSTATE_SUB_PREPROCESSOR_MAIN;
 
 /* event variable to store event and related properties */
-static pevent_t pevent_data;
-static int event_data_idx=0;
+static __thread pevent_t pevent_data;
+static __thread int event_data_idx=0;
+static __thread int comment_prev = 0; // last char read in a multi line comment
+static __thread int read_last = '\n';  // last char read from the file
+static __thread int read_prev = '\n';  // char read before the one being handled
+
+static __thread char word[WORD_BUFF_SIZE];
+static __thread int word_idx=0;
+static __thread pevent_e word_type = PEVENT_REGULAR_EXP; // event of the word in word[]
+static __thread int word_property = 0;
+static __thread int literal_quote = 0;   // quote closing the string or char being read
+static __thread int literal_escape = 0;  // the previous char of the literal was a backslash
+
+
+/* language of the file being parsed, chooses keywords, comments and byte classes */
+static __thread const lang_t *lang = &lang_c;
+
+/********** preprocessor conditionals **********/
+
+#define PP_NAME_SIZE		64
+#define PP_LINE_SIZE		(PEVENT_DATA_SIZE - 8)  // longest directive line handed out as one event
+#define PP_COND_DEPTH		64                      // nested conditionals tracked
+#define PP_FILE_MACROS		128                     // #define / #undef tracked per file
 
-static char word[WORD_BUFF_SIZE];
-static int word_idx=0;
+/* branch flags of an open conditional */
+#define PP_BRANCH_LIVE		0x1   // code of the current branch is compiled (or cannot be decided)
+#define PP_BRANCH_TAKEN		0x2   // an earlier branch was compiled, the following ones are not
+#define PP_BRANCH_UNKNOWN	0x4   // an earlier condition could not be evaluated, all branches stay live
 
+/* value of a condition, only what can be decided for sure is folded */
+typedef enum
+{
+	PP_FALSE,
+	PP_TRUE,
+	PP_UNKNOWN
+} pp_value_e;
+
+typedef enum
+{
+	PP_DIR_OTHER,
+	PP_DIR_IF,
+	PP_DIR_IFDEF,
+	PP_DIR_IFNDEF,
+	PP_DIR_ELIF,
+	PP_DIR_ELIFDEF,
+	PP_DIR_ELIFNDEF,
+	PP_DIR_ELSE,
+	PP_DIR_ENDIF,
+	PP_DIR_DEFINE,
+	PP_DIR_UNDEF,
+	PP_DIR_COUNT
+} pp_dir_e;
+
+static const char *const pp_directives[PP_DIR_COUNT] = {
+	[PP_DIR_OTHER]    = "",
+	[PP_DIR_IF]       = "if",
+	[PP_DIR_IFDEF]    = "ifdef",
+	[PP_DIR_IFNDEF]   = "ifndef",
+	[PP_DIR_ELIF]     = "elif",
+	[PP_DIR_ELIFDEF]  = "elifdef",
+	[PP_DIR_ELIFNDEF] = "elifndef",
+	[PP_DIR_ELSE]     = "else",
+	[PP_DIR_ENDIF]    = "endif",
+	[PP_DIR_DEFINE]   = "define",
+	[PP_DIR_UNDEF]    = "undef",
+};
+
+typedef struct
+{
+	char name[PP_NAME_SIZE];
+	int defined;            // 0 after #undef
+	pp_value_e value;       // value in #if expressions
+} pp_macro_t;
 
-static char* res_kwords_data[] = {"const", "volatile", "extern", "auto", "register",
-   						   "static", "signed", "unsigned", "short", "long", 
-						   "double", "char", "int", "float", "struct", 
-						   "union", "enum", "void", "typedef", ""
-						  };
+/* condition expression being evaluated */
+typedef struct
+{
+	const char *pos;
+	int error;              // expression is not understood, its value is PP_UNKNOWN
+} pp_expr_t;
+
+/* macros given on the command line, set before parsing starts */
+static pp_macro_t pp_macros[PEVENT_MAX_MACROS];
+static int pp_macro_count = 0;
+
+/* macros defined or undefined by the file being parsed */
+static __thread pp_macro_t pp_file_macros[PP_FILE_MACROS];
+static __thread int pp_file_macro_count = 0;
+static __thread int pp_file_macros_lost = 0; // table was full, unknown names cannot be decided
+
+/* open conditionals of the file being parsed (outside inactive regions) */
+static __thread unsigned char pp_cond[PP_COND_DEPTH];
+static __thread int pp_depth = 0;
+
+/* scanning state of an inactive region */
+static __thread int pp_skip_nest = 0;   // conditionals opened inside the region
+static __thread int pp_skip_in = 0;     // inside a literal ('"', '\''), block ('*') or line ('/') comment
+static __thread int pp_skip_prev = 0;   // previous char of the region
+
+/* directives start a line: only blanks read since the last line end, and the
+ * same before the char being handled
+ */
+static __thread int pp_line_blank = 1;
+static __thread int pp_line_start = 1;
 
-static char* res_kwords_non_data[] = {"goto", "return", "continue", "break", 
-							   "if", "else", "for", "while", "do", 
-							   "switch", "case", "default","sizeof", ""
-							  };
+/* rest of a conditional directive line longer than one event, and the state following it */
+static __thread long pp_line_left = 0;
+static __thread pstate_e pp_line_next = PSTATE_IDLE;
 
 static char operators[] = {'/', '+', '*', '-', '%', '=', '<', '>', '~', '&', ',', '!', '^', '|'};
 static char symbols[] = {'(', ')', '{', '[', ':'};
@@ -77,6 +182,9 @@ pevent_t * pstate_ascii_char_handler(FILE *fd, int ch);
 pevent_t * pstate_reserve_keyword_handler(FILE *fd, int ch);
 pevent_t * pstate_preprocessor_directive_handler(FILE *fd, int ch);
 pevent_t * pstate_sub_preprocessor_main_handler(FILE *fd, int ch);
+pevent_t * pstate_inactive_region_handler(FILE *fd, int ch);
+pevent_t * pstate_raw_string_handler(FILE *fd, int ch);
+pevent_t * pstate_directive_line_handler(FILE *fd, int ch);
 
 /********** Utility functions **********/
 
@@ -86,17 +194,17 @@ static int is_reserved_keyword(char *word)
 	int idx = 0;
 
 	/* search for data type reserved keyword */
-	while(*res_kwords_data[idx])
+	while(*lang->keywords_data[idx])
 	{
-		if(strcmp(res_kwords_data[idx++], word) == 0)
+		if(strcmp(lang->keywords_data[idx++], word) == 0)
 			return RES_KEYWORD_DATA;
 	}
 
 	idx = 0; // reset index
 	/* search for non data type reserved key word */
-	while(*res_kwords_non_data[idx])
+	while(*lang->keywords_non_data[idx])
 	{
-		if(strcmp(res_kwords_non_data[idx++], word) == 0)
+		if(strcmp(lang->keywords_non_data[idx++], word) == 0)
 			return RES_KEYWORD_NON_DATA;
 	}
 
@@ -137,6 +245,512 @@ static void set_parser_event(pstate_e s, pevent_e e)
 	event_data_idx = 0;
 	state = s;
 	pevent_data.type = e;
+	pevent_data.property = 0;
+}
+
+/********** Preprocessor conditional functions **********/
+
+/* forgets the conditionals and macros of the previous file */
+static void pp_reset(void)
+{
+	pp_depth = 0;
+	pp_file_macro_count = 0;
+	pp_file_macros_lost = 0;
+	pp_line_blank = 1;
+}
+
+/* follows a char read from the source for pp_line_blank */
+static void pp_track(int ch)
+{
+	if(ch == '\n')
+		pp_line_blank = 1;
+	else if(ch != ' ' && ch != '\t')
+		pp_line_blank = 0;
+}
+
+static void pp_skip_blanks(pp_expr_t *expr)
+{
+	while(*expr->pos == ' ' || *expr->pos == '\t')
+		expr->pos++;
+}
+
+/* reads an identifier into 'name', returns 0 if there is none */
+static int pp_name(pp_expr_t *expr, char *name)
+{
+	int len = 0;
+
+	pp_skip_blanks(expr);
+	if(!isalpha((unsigned char)*expr->pos) && *expr->pos != '_')
+		return 0;
+	while(isalnum((unsigned char)*expr->pos) || *expr->pos == '_')
+	{
+		if(len < PP_NAME_SIZE - 1)
+			name[len++] = *expr->pos;
+		expr->pos++;
+	}
+	name[len] = '\0';
+
+	return 1;
+}
+
+/* maps a directive name to its kind */
+static pp_dir_e pp_directive_kind(const char *name)
+{
+	int idx;
+
+	for(idx = PP_DIR_OTHER + 1; idx < PP_DIR_COUNT; idx++)
+	{
+		if(strcmp(pp_directives[idx], name) == 0)
+			return idx;
+	}
+
+	return PP_DIR_OTHER;
+}
+
+/* value of an integer constant, PP_UNKNOWN for anything else */
+static pp_value_e pp_literal_value(const char *text)
+{
+	char *end;
+	long value;
+
+	while(*text == ' ' || *text == '\t')
+		text++;
+	if(!isdigit((unsigned char)*text))
+		return PP_UNKNOWN;
+
+	value = strtol(text, &end, 0);
+	while(*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L')
+		end++;
+	while(*end == ' ' || *end == '\t')
+		end++;
+
+	return (*end != '\0') ? PP_UNKNOWN : (value ? PP_TRUE : PP_FALSE);
+}
+
+/* finds a macro of the file or the command line, NULL if it was never defined */
+static pp_macro_t *pp_lookup(const char *name)
+{
+	int idx;
+
+	for(idx = 0; idx < pp_file_macro_count; idx++)
+	{
+		if(strcmp(pp_file_macros[idx].name, name) == 0)
+			return &pp_file_macros[idx];
+	}
+	for(idx = 0; idx < pp_macro_count; idx++)
+	{
+		if(strcmp(pp_macros[idx].name, name) == 0)
+			return &pp_macros[idx];
+	}
+
+	return NULL;
+}
+
+/* result of defined(name) */
+static pp_value_e pp_defined(const char *name)
+{
+	pp_macro_t *macro = pp_lookup(name);
+
+	if(macro == NULL)
+		return pp_file_macros_lost ? PP_UNKNOWN : PP_FALSE;
+
+	return macro->defined ? PP_TRUE : PP_FALSE;
+}
+
+/* value of a name in an #if expression, undefined names are 0 */
+static pp_value_e pp_macro_value(const char *name)
+{
+	pp_macro_t *macro = pp_lookup(name);
+
+	if(macro == NULL)
+		return pp_file_macros_lost ? PP_UNKNOWN : PP_FALSE;
+
+	return macro->defined ? macro->value : PP_FALSE;
+}
+
+static pp_value_e pp_eval_or(pp_expr_t *expr);
+
+/* evaluates a number, name, defined(name), !operand or (expression) */
+static pp_value_e pp_eval_operand(pp_expr_t *expr)
+{
+	char name[PP_NAME_SIZE];
+	char number[PP_NAME_SIZE];
+	pp_value_e value;
+	int paren, len = 0;
+
+	pp_skip_blanks(expr);
+	if(*expr->pos == '!' && expr->pos[1] != '=')
+	{
+		expr->pos++;
+		value = pp_eval_operand(expr);
+		return (value == PP_TRUE) ? PP_FALSE : (value == PP_FALSE) ? PP_TRUE : PP_UNKNOWN;
+	}
+	if(*expr->pos == '(')
+	{
+		expr->pos++;
+		value = pp_eval_or(expr);
+		pp_skip_blanks(expr);
+		if(*expr->pos == ')')
+			expr->pos++;
+		else
+			expr->error = 1;
+		return value;
+	}
+	if(isdigit((unsigned char)*expr->pos))
+	{
+		while(isalnum((unsigned char)*expr->pos) && len < PP_NAME_SIZE - 1)
+			number[len++] = *expr->pos++;
+		number[len] = '\0';
+		return pp_literal_value(number);
+	}
+	if(!pp_name(expr, name))
+	{
+		expr->error = 1;
+		return PP_UNKNOWN;
+	}
+	if(strcmp(name, "defined") != 0)
+		return pp_macro_value(name);
+
+	pp_skip_blanks(expr);
+	if((paren = (*expr->pos == '(')))
+		expr->pos++;
+	if(!pp_name(expr, name))
+	{
+		expr->error = 1;
+		return PP_UNKNOWN;
+	}
+	pp_skip_blanks(expr);
+	if(paren && *expr->pos == ')')
+		expr->pos++;
+	else if(paren)
+		expr->error = 1;
+
+	return pp_defined(name);
+}
+
+/* operand && operand ..., false wins over unknown */
+static pp_value_e pp_eval_and(pp_expr_t *expr)
+{
+	pp_value_e value = pp_eval_operand(expr), next;
+
+	for(pp_skip_blanks(expr); expr->pos[0] == '&' && expr->pos[1] == '&'; pp_skip_blanks(expr))
+	{
+		expr->pos += 2;
+		next = pp_eval_operand(expr);
+		if(value == PP_FALSE || next == PP_FALSE)
+			value = PP_FALSE;
+		else if(next == PP_UNKNOWN)
+			value = PP_UNKNOWN;
+	}
+
+	return value;
+}
+
+/* operand || operand ..., true wins over unknown */
+static pp_value_e pp_eval_or(pp_expr_t *expr)
+{
+	pp_value_e value = pp_eval_and(expr), next;
+
+	for(pp_skip_blanks(expr); expr->pos[0] == '|' && expr->pos[1] == '|'; pp_skip_blanks(expr))
+	{
+		expr->pos += 2;
+		next = pp_eval_and(expr);
+		if(value == PP_TRUE || next == PP_TRUE)
+			value = PP_TRUE;
+		else if(next == PP_UNKNOWN)
+			value = PP_UNKNOWN;
+	}
+
+	return value;
+}
+
+/* evaluates the condition of a directive, PP_UNKNOWN if it is not understood
+ * or not known ('text' NULL, the line was too long to keep)
+ */
+static pp_value_e pp_condition(pp_dir_e kind, const char *text)
+{
+	pp_expr_t expr = { text, 0 };
+	char name[PP_NAME_SIZE];
+	pp_value_e value = PP_UNKNOWN;
+
+	if(text == NULL)
+		return PP_UNKNOWN;
+	if(kind == PP_DIR_IF || kind == PP_DIR_ELIF)
+		value = pp_eval_or(&expr);
+	else if(pp_name(&expr, name))
+		value = pp_defined(name);
+	else
+		expr.error = 1;
+
+	pp_skip_blanks(&expr);
+	if(expr.error || *expr.pos != '\0')
+		return PP_UNKNOWN;
+
+	if(kind == PP_DIR_IFNDEF || kind == PP_DIR_ELIFNDEF)
+		value = (value == PP_TRUE) ? PP_FALSE : (value == PP_FALSE) ? PP_TRUE : PP_UNKNOWN;
+
+	return value;
+}
+
+/* records #define / #undef of the file being parsed, the value is not
+ * evaluated unless the 'whole' line was kept
+ */
+static void pp_define(pp_dir_e kind, const char *text, int whole)
+{
+	pp_expr_t expr = { text, 0 };
+	char name[PP_NAME_SIZE];
+	pp_macro_t *macro = NULL;
+	int idx;
+
+	if(!pp_name(&expr, name))
+		return;
+
+	for(idx = 0; idx < pp_file_macro_count; idx++)
+	{
+		if(strcmp(pp_file_macros[idx].name, name) == 0)
+			macro = &pp_file_macros[idx];
+	}
+	if(macro == NULL)
+	{
+		if(pp_file_macro_count == PP_FILE_MACROS)
+		{
+			pp_file_macros_lost = 1;
+			return;
+		}
+		macro = &pp_file_macros[pp_file_macro_count++];
+		strcpy(macro->name, name);
+	}
+
+	macro->defined = (kind == PP_DIR_DEFINE);
+	/* function like macros and replacement lists other than a number are not evaluated */
+	macro->value = (*expr.pos == '(' || !whole) ? PP_UNKNOWN : pp_literal_value(expr.pos);
+}
+
+/* updates the open conditionals for a conditional directive,
+ * returns non zero if the code following it is live
+ */
+static int pp_branch(pp_dir_e kind, const char *text)
+{
+	unsigned char *cond;
+	pp_value_e value;
+
+	/* #elif / #else without a tracked #if are left live */
+	if(kind != PP_DIR_IF && kind != PP_DIR_IFDEF && kind != PP_DIR_IFNDEF && kind != PP_DIR_ENDIF &&
+	   (pp_depth == 0 || pp_depth > PP_COND_DEPTH))
+		return 1;
+	cond = (pp_depth > 0 && pp_depth <= PP_COND_DEPTH) ? &pp_cond[pp_depth - 1] : NULL;
+
+	switch(kind)
+	{
+		case PP_DIR_IF :
+		case PP_DIR_IFDEF :
+		case PP_DIR_IFNDEF :
+			if(pp_depth++ >= PP_COND_DEPTH) // too deep to track, keep it live
+				return 1;
+			cond = &pp_cond[pp_depth - 1];
+			value = pp_condition(kind, text);
+			*cond = (value == PP_FALSE) ? 0 :
+					(value == PP_TRUE) ? (PP_BRANCH_LIVE | PP_BRANCH_TAKEN) : (PP_BRANCH_LIVE | PP_BRANCH_UNKNOWN);
+			break;
+		case PP_DIR_ELIF :
+		case PP_DIR_ELIFDEF :
+		case PP_DIR_ELIFNDEF :
+			if(*cond & PP_BRANCH_UNKNOWN)
+				break;
+			if(*cond & PP_BRANCH_TAKEN)
+			{
+				*cond &= ~PP_BRANCH_LIVE;
+				break;
+			}
+			value = pp_condition(kind, text);
+			*cond = (value == PP_FALSE) ? 0 :
+					(value == PP_TRUE) ? (PP_BRANCH_LIVE | PP_BRANCH_TAKEN) : (PP_BRANCH_LIVE | PP_BRANCH_UNKNOWN);
+			break;
+		case PP_DIR_ELSE :
+			if(*cond & PP_BRANCH_UNKNOWN)
+				break;
+			*cond = (*cond & PP_BRANCH_TAKEN) ? PP_BRANCH_TAKEN : (PP_BRANCH_LIVE | PP_BRANCH_TAKEN);
+			break;
+		case PP_DIR_ENDIF :
+			if(pp_depth > 0)
+				pp_depth--;
+			return 1;
+		default :
+			return 1;
+	}
+
+	return *cond & PP_BRANCH_LIVE;
+}
+
+/* reads the rest of a directive line after its '#' into 'raw' (starting with
+ * the '#', up to and with the line end) and 'clean' (comments replaced by a
+ * blank, continued lines joined). A line longer than PP_LINE_SIZE is read to
+ * its end, but only its start is kept. Returns the length of the whole line.
+ */
+static long pp_read_line(FILE *fd, char *raw, char *clean)
+{
+	long len = 0;
+	int clean_len = 0, comment = 0, prev = 0, ch;
+
+	raw[len++] = '#';
+	while((ch = fgetc(fd)) != EOF)
+	{
+		if(len < PP_LINE_SIZE)
+			raw[len] = ch;
+		len++;
+
+		if(comment == '*') // a block comment may go on over several lines
+		{
+			if(prev == lang->block_close[0] && ch == lang->block_close[1])
+			{
+				comment = 0;
+				ch = 0;
+			}
+		}
+		else if(ch == '\n')
+		{
+			if(comment || prev != '\\')
+				break;
+			clean_len--; // continued line, drop the backslash
+		}
+		else if(comment == 0 && clean_len > 0 && prev == lang->block_open[0] && ch == lang->block_open[1])
+		{
+			clean[clean_len - 1] = ' ';
+			comment = '*';
+			ch = 0;
+		}
+		else if(comment == 0 && clean_len > 0 && prev == lang->line_comment[0] && ch == lang->line_comment[1])
+		{
+			clean[clean_len - 1] = ' ';
+			comment = '/';
+		}
+		else if(comment == 0 && clean_len < PP_LINE_SIZE - 1)
+		{
+			clean[clean_len++] = ch;
+		}
+		prev = ch;
+	}
+	clean[clean_len] = '\0';
+
+	return len;
+}
+
+/* handles a directive at the start of a line (its '#' was just read).
+ * Every directive line is handed out as a directive event; conditionals
+ * decide whether an inactive region follows, #define / #undef are recorded.
+ */
+static pevent_t *pp_directive(FILE *fd)
+{
+	char raw[PP_LINE_SIZE], clean[PP_LINE_SIZE], name[PP_NAME_SIZE];
+	long start = ftell(fd);
+	pp_expr_t expr = { clean, 0 };
+	pp_dir_e kind = PP_DIR_OTHER;
+	long len;
+	int whole, cut, idx;
+
+	len = pp_read_line(fd, raw, clean);
+	whole = (len <= PP_LINE_SIZE);
+	if(pp_name(&expr, name))
+		kind = pp_directive_kind(name);
+
+	if(event_data_idx) // we have regular exp in buffer first process that
+	{
+		fseek(fd, start - 1, SEEK_SET); // unget the whole line
+		pp_line_blank = 1;
+		set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+		return &pevent_data;
+	}
+
+	if(kind == PP_DIR_DEFINE || kind == PP_DIR_UNDEF)
+		pp_define(kind, expr.pos, whole);
+
+	/* the condition of a line too long to keep is unknown, its branches stay live */
+	pp_line_next = pp_branch(kind, whole ? expr.pos : NULL) ? PSTATE_IDLE : PSTATE_INACTIVE_REGION;
+	pp_skip_nest = 0;
+	pp_skip_in = 0;
+	pp_skip_prev = '\n';
+	if(whole)
+	{
+		memcpy(pevent_data.data, raw, len);
+		event_data_idx = len;
+		pp_line_blank = 1; // the line was read up to its end
+		set_parser_event(pp_line_next, PEVENT_PREPROCESSOR_DIRECTIVE);
+		return &pevent_data;
+	}
+
+	/* hand out the kept start, not splitting a UTF-8 character, and read the
+	 * rest of the line again in the directive line state
+	 */
+	cut = PP_LINE_SIZE;
+	for(idx = cut - 1; idx > 0 && idx > cut - 4 && ((unsigned char)raw[idx] & 0xC0) == 0x80; idx--)
+		;
+	if((unsigned char)raw[idx] >= 0xC0 && idx + 1 + UTF8_TAIL_LEN((unsigned char)raw[idx]) > cut)
+		cut = idx;
+	memcpy(pevent_data.data, raw, cut);
+	event_data_idx = cut;
+	fseek(fd, start + cut - 1, SEEK_SET);
+	pp_line_left = len - cut;
+	pp_line_blank = 0;
+	set_parser_event(PSTATE_DIRECTIVE_LINE, PEVENT_PREPROCESSOR_DIRECTIVE);
+
+	return &pevent_data;
+}
+
+/********** Word functions **********/
+
+/* tells whether a char continues a word or number (UTF-8 letters included) */
+static int is_word_char(int ch)
+{
+	return isalnum(ch) || ch == '_' || ch >= 0x80;
+}
+
+/* reads a word (or number) starting with 'ch' into word[]. A longer word is
+ * cut at WORD_BUFF_SIZE - 1 chars, its rest follows as text.
+ */
+static void read_word(FILE *fd, int ch, int number)
+{
+	int next, hex, exponent, separator;
+
+	word_idx = 0;
+	word[word_idx++] = ch;
+	while(word_idx < WORD_BUFF_SIZE - 1 && (next = fgetc(fd)) != EOF)
+	{
+		/* numbers also take a decimal point, the sign of an exponent (1.5e-3, 0x1p+4)
+		 * and digit separators where a quote cannot follow a number otherwise (3'000)
+		 */
+		hex = (word_idx > 1 && (word[1] == 'x' || word[1] == 'X'));
+		exponent = hex ? (word[word_idx - 1] == 'p' || word[word_idx - 1] == 'P') :
+						 (word[word_idx - 1] == 'e' || word[word_idx - 1] == 'E');
+		separator = (next == '\'' && lang->classes['\''] == LANG_CC_CHAR && isalnum(word[word_idx - 1]));
+		if((!is_word_char(next) && !(number && (next == '.' || separator || ((next == '+' || next == '-') && exponent)))) ||
+		   (next >= 0xC0 && word_idx + 4 > WORD_BUFF_SIZE - 1)) // no UTF-8 char is cut
+		{
+			ungetc(next, fd);
+			break;
+		}
+		pp_track(next);
+		read_prev = read_last;
+		read_last = next;
+		word[word_idx++] = next;
+	}
+	word[word_idx] = '\0';
+}
+
+/* hands out the word in word[] as its own event, or adds it to the
+ * (empty) text buffer if it is plain text. Returns NULL then.
+ */
+static pevent_t *word_event(void)
+{
+	memcpy(&pevent_data.data[event_data_idx], word, word_idx);
+	event_data_idx += word_idx;
+	word_idx = 0;
+	if(word_type == PEVENT_REGULAR_EXP)
+		return NULL;
+
+	set_parser_event(PSTATE_IDLE, word_type);
+	pevent_data.property = word_property;
+
+	return &pevent_data;
 }
 
 
@@ -149,12 +763,63 @@ pevent_t *get_parser_event(FILE *fd)
 {
 	int ch, pre_ch;
 	pevent_t *evptr = NULL;
+
+	/* a word read after text follows that text */
+	if(word_idx && (evptr = word_event()) != NULL)
+		return evptr;
+
 	/* Read char by char */
 	while((ch = fgetc(fd)) != EOF)
 	{
 #ifdef DEBUG
 	//	putchar(ch);
 #endif
+		/* event buffer is almost full (handlers store up to two chars at once),
+		 * hand out the collected part and continue in the same state. Never
+		 * split inside a UTF-8 character (continuation bytes are 10xxxxxx),
+		 * the margin leaves room for the up to three continuation bytes.
+		 */
+		if(event_data_idx >= PEVENT_DATA_SIZE - 8 && (ch & 0xC0) != 0x80)
+		{
+			switch(state)
+			{
+				case PSTATE_IDLE :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+					return &pevent_data;
+				case PSTATE_SINGLE_LINE_COMMENT :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_SINGLE_LINE_COMMENT, PEVENT_SINGLE_LINE_COMMENT);
+					return &pevent_data;
+				case PSTATE_MULTI_LINE_COMMENT :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_MULTI_LINE_COMMENT, PEVENT_MULTI_LINE_COMMENT);
+					return &pevent_data;
+				case PSTATE_INACTIVE_REGION :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_INACTIVE_REGION, PEVENT_INACTIVE_REGION);
+					return &pevent_data;
+				case PSTATE_RAW_STRING :
+				case PSTATE_STRING :
+					ungetc(ch, fd);
+					set_parser_event(state, PEVENT_STRING);
+					return &pevent_data;
+				case PSTATE_ASCII_CHAR :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_ASCII_CHAR, PEVENT_ASCII_CHAR);
+					return &pevent_data;
+				case PSTATE_DIRECTIVE_LINE :
+					ungetc(ch, fd);
+					set_parser_event(PSTATE_DIRECTIVE_LINE, PEVENT_PREPROCESSOR_DIRECTIVE);
+					return &pevent_data;
+				default :
+					break;
+			}
+		}
+		pp_line_start = pp_line_blank;
+		pp_track(ch);
+		read_prev = read_last;
+		read_last = ch;
 		switch(state)
 		{
 			case PSTATE_IDLE :
@@ -193,6 +858,18 @@ pevent_t *get_parser_event(FILE *fd)
 				if((evptr = pstate_ascii_char_handler(fd, ch)) != NULL)
 					return evptr;
 				break;
+			case PSTATE_INACTIVE_REGION :
+				if((evptr = pstate_inactive_region_handler(fd, ch)) != NULL)
+					return evptr;
+				break;
+			case PSTATE_RAW_STRING :
+				if((evptr = pstate_raw_string_handler(fd, ch)) != NULL)
+					return evptr;
+				break;
+			case PSTATE_DIRECTIVE_LINE :
+				if((evptr = pstate_directive_line_handler(fd, ch)) != NULL)
+					return evptr;
+				break;
 			default : 
 				printf("unknown state\n");
 				state = PSTATE_IDLE;
@@ -200,13 +877,128 @@ pevent_t *get_parser_event(FILE *fd)
 		}
 	}
 
+	/* an inactive region open at the end of file is handed out before the EOF event */
+	if(state == PSTATE_INACTIVE_REGION && event_data_idx)
+	{
+		set_parser_event(PSTATE_IDLE, PEVENT_INACTIVE_REGION);
+		return &pevent_data;
+	}
+
+	/* an unterminated string or char constant is handed out as it is */
+	if((state == PSTATE_RAW_STRING || state == PSTATE_STRING) && event_data_idx)
+	{
+		set_parser_event(PSTATE_IDLE, PEVENT_STRING);
+		return &pevent_data;
+	}
+	if(state == PSTATE_ASCII_CHAR && event_data_idx)
+	{
+		set_parser_event(PSTATE_IDLE, PEVENT_ASCII_CHAR);
+		return &pevent_data;
+	}
+	/* so is the rest of a directive line cut short by the end of file */
+	if(state == PSTATE_DIRECTIVE_LINE && event_data_idx)
+	{
+		set_parser_event(PSTATE_IDLE, PEVENT_PREPROCESSOR_DIRECTIVE);
+		return &pevent_data;
+	}
+
 	/* end of file is reached, move back to idle state and set EOF event */
 	set_parser_event(PSTATE_IDLE, PEVENT_EOF);
+	read_last = '\n';
+	pp_reset();
 
 	return &pevent_data; // return final event
 }
 
 
+/* This function copies an event into the arena, the copy stays valid
+ * until the arena is reset. Returns NULL if the arena is out of memory.
+ */
+ptoken_t *pevent_store(arena_t *arena, pevent_t *event)
+{
+	ptoken_t *token;
+
+	if((token = arena_alloc(arena, ARENA_CLASS_RECORD, sizeof(ptoken_t))) == NULL)
+		return NULL;
+	if((token->data = arena_strndup(arena, event->data, event->length)) == NULL)
+		return NULL;
+
+	token->type = event->type;
+	token->property = event->property;
+	token->length = event->length;
+	token->next = NULL;
+
+	return token;
+}
+
+/* This function parses the source file into a linked token stream stored in
+ * the arena: the next 'max_tokens' events, or the whole file if max_tokens is
+ * 0. *at_eof is set once the EOF token was stored. All tokens are released
+ * together by resetting the arena. Returns NULL if the arena is out of memory.
+ */
+ptoken_t *get_parser_tokens(FILE *fd, arena_t *arena, int max_tokens, int *at_eof)
+{
+	ptoken_t *head = NULL, **tail = &head;
+	pevent_t *event;
+	int count = 0;
+
+	*at_eof = 0;
+	do
+	{
+		event = get_parser_event(fd);
+		if((*tail = pevent_store(arena, event)) == NULL)
+			return NULL;
+		tail = &(*tail)->next;
+	} while(event->type != PEVENT_EOF && ++count != max_tokens);
+
+	*at_eof = (event->type == PEVENT_EOF);
+
+	return head;
+}
+
+/* This function sets the language of the next file parsed by this thread,
+ * call it before the first event of the file.
+ */
+void set_parser_language(const lang_t *language)
+{
+	lang = language;
+	state = PSTATE_IDLE;
+	word_idx = 0;
+	read_last = '\n';
+	pp_reset();
+}
+
+/* This function defines a macro for evaluating conditionals of all files
+ * parsed afterwards, 'definition' is "NAME" (value 1) or "NAME=VALUE".
+ * Call it before parsing starts. Returns 0, or -1 if the name is invalid or
+ * PEVENT_MAX_MACROS are defined already.
+ */
+int add_parser_macro(const char *definition)
+{
+	const char *eq = strchr(definition, '=');
+	size_t len = eq ? (size_t)(eq - definition) : strlen(definition);
+	pp_macro_t *macro;
+	size_t idx;
+
+	if(pp_macro_count == PEVENT_MAX_MACROS || len == 0 || len >= PP_NAME_SIZE ||
+	   isdigit((unsigned char)definition[0]))
+		return -1;
+	for(idx = 0; idx < len; idx++)
+	{
+		if(!isalnum((unsigned char)definition[idx]) && definition[idx] != '_')
+			return -1;
+	}
+
+	macro = &pp_macros[pp_macro_count++];
+	memcpy(macro->name, definition, len);
+	macro->name[len] = '\0';
+	macro->defined = 1;
+	macro->value = eq ? pp_literal_value(eq + 1) : PP_TRUE;
+
+	return 0;
+}
+
+
 /********** IDLE state Handler **********
  * Idle state handler identifies
  ****************************************/
@@ -214,69 +1006,139 @@ pevent_t *get_parser_event(FILE *fd)
 pevent_t * pstate_idle_handler(FILE *fd, int ch)
 {
 	int pre_ch;
-	switch(ch)
+	int cls = lang->classes[(unsigned char)ch];
+
+	switch(cls)
 	{
-		case '\'' : // begining of ASCII char 
+		case LANG_CC_CHAR : // begining of ASCII char 
+		case LANG_CC_STRING : // collected up to the closing quote
+			if(event_data_idx) // we have regular exp in buffer first process that
+			{
+				ungetc(ch, fd); // unget char
+				read_last = read_prev; // read it again after the same char
+				set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+				return &pevent_data;
+			}
+			state = (cls == LANG_CC_STRING) ? PSTATE_STRING : PSTATE_ASCII_CHAR;
+			literal_quote = ch;
+			literal_escape = 0;
+			pevent_data.data[event_data_idx++] = ch;
 			break;
 
-		case '/' :
+		case LANG_CC_COMMENT :
+			if(lang->line_comment[1] == '\0') // single char line comment, e.g. shell '#'
+			{
+				if(!lang_comment_starts(lang, read_prev)) // inside a word, e.g. $#
+				{
+					pevent_data.data[event_data_idx++] = ch;
+					break;
+				}
+				if(event_data_idx) // we have regular exp in buffer first process that
+				{
+					ungetc(ch, fd); // unget char
+					read_last = read_prev; // read it again after the same char
+					set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+					return &pevent_data;
+				}
+				state = PSTATE_SINGLE_LINE_COMMENT;
+				pevent_data.data[event_data_idx++] = ch;
+				break;
+			}
 			pre_ch = ch;
-			if((ch = fgetc(fd)) == '*') // multi line comment
+			pp_track(ch = fgetc(fd));
+			if(pre_ch == lang->block_open[0] && ch == lang->block_open[1]) // multi line comment
 			{
 				if(event_data_idx) // we have regular exp in buffer first process that
 				{
-					fseek(fd, -2L, SEEK_CUR); // unget chars
+					ungetc(ch, fd); // unget chars
+					ungetc(pre_ch, fd);
 					set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
 					return &pevent_data;
 				}
 				else //	multi line comment begin 
 				{
 #ifdef DEBUG	
-					printf("Multi line comment Begin : /*\n");
+					printf("Multi line comment Begin : %s\n", lang->block_open);
 #endif
 					state = PSTATE_MULTI_LINE_COMMENT;
+					comment_prev = ch;
 					pevent_data.data[event_data_idx++] = pre_ch;
 					pevent_data.data[event_data_idx++] = ch;
 				}
 			}
-			else if(ch == '/') // single line comment
+			else if(pre_ch == lang->line_comment[0] && ch == lang->line_comment[1]) // single line comment
 			{
 				if(event_data_idx) // we have regular exp in buffer first process that
 				{
-					fseek(fd, -2L, SEEK_CUR); // unget chars
+					ungetc(ch, fd); // unget chars
+					ungetc(pre_ch, fd);
 					set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
 					return &pevent_data;
 				}
 				else //	single line comment begin
 				{
 #ifdef DEBUG	
-					printf("Single line comment Begin : //\n");
+					printf("Single line comment Begin : %s\n", lang->line_comment);
 #endif
 					state = PSTATE_SINGLE_LINE_COMMENT;
 					pevent_data.data[event_data_idx++] = pre_ch;
 					pevent_data.data[event_data_idx++] = ch;
 				}
 			}
-			else // it is regular exp
+			else // it is regular exp, the next char is lexed on its own
 			{
 				pevent_data.data[event_data_idx++] = pre_ch;
-				pevent_data.data[event_data_idx++] = ch;
+				ungetc(ch, fd);
 			}
 			break;
-		case '#' :
-
-			break;
-		case '\"' :
+		case LANG_CC_PREPROCESSOR : // a directive line, elsewhere plain text
+			if(pp_line_start)
+				return pp_directive(fd);
+			pevent_data.data[event_data_idx++] = ch;
 			break;
 
-		case '0' ... '9' : // detect numeric constant
+		case LANG_CC_RAW_STRING : // collected up to the closing quote, comments are not looked for inside
+			if(event_data_idx) // we have regular exp in buffer first process that
+			{
+				ungetc(ch, fd); // unget char
+				set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+				return &pevent_data;
+			}
+			state = PSTATE_RAW_STRING;
+			pevent_data.data[event_data_idx++] = ch;
 			break;
 
-		case 'a' ... 'z' : // could be reserved key word
-
-			break;
+		case LANG_CC_DIGIT : // detect numeric constant
+		case LANG_CC_WORD : // could be reserved key word
+			if(is_word_char(read_prev)) // inside a word, e.g. x1 or sizeof_t
+			{
+				pevent_data.data[event_data_idx++] = ch;
+				break;
+			}
+			read_word(fd, ch, cls == LANG_CC_DIGIT);
+			word_type = PEVENT_REGULAR_EXP;
+			word_property = 0;
+			if(cls == LANG_CC_DIGIT)
+				word_type = PEVENT_NUMERIC_CONSTANT;
+			else if((word_property = is_reserved_keyword(word)) != 0)
+				word_type = PEVENT_RESERVE_KEYWORD;
+
+			/* plain words join the text, if it has room for them */
+			if(word_type == PEVENT_REGULAR_EXP && event_data_idx + word_idx <= PEVENT_DATA_SIZE - 8)
+				return word_event();
+			if(event_data_idx) // text first, the word follows with the next event
+			{
+				set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+				return &pevent_data;
+			}
+			return word_event();
 		default : // Assuming common text starts by default.
 			pevent_data.data[event_data_idx++] = ch;
+			/* the input is valid UTF-8, copy the rest of a multibyte character at once
+			 * (continuation bytes are no blanks, pp_line_blank stays 0)
+			 */
+			if(ch >= 0xC0)
+				event_data_idx += fread(&pevent_data.data[event_data_idx], 1, UTF8_TAIL_LEN(ch), fd);
 			break;
 	}
 
@@ -314,8 +1176,8 @@ pevent_t * pstate_preprocessor_directive_handler(FILE *fd, int ch)
 pevent_t *pstate_sub_preprocessor_main_handler(FILE *fd, int ch) 
 {
     // Use a buffer to hold the current word being read
-    static char word[WORD_BUFF_SIZE];
-    static int word_idx = 0;
+    static __thread char word[WORD_BUFF_SIZE];
+    static __thread int word_idx = 0;
 
     // Clear the word buffer if we're starting a new event
     if (word_idx == 0) {
@@ -377,9 +1239,9 @@ pevent_t *pstate_sub_preprocessor_main_handler(FILE *fd, int ch)
 pevent_t *pstate_header_file_handler(FILE *fd, int ch) 
 {
     // Use a buffer to hold the header file name
-    static char header_file_name[PEVENT_DATA_SIZE];
-    static int index = 0;
-    static int is_quoted = 0; // To check if it's enclosed in quotes
+    static __thread char header_file_name[PEVENT_DATA_SIZE];
+    static __thread int index = 0;
+    static __thread int is_quoted = 0; // To check if it's enclosed in quotes
 
     // Clear the buffer if we are starting a new header file
     if (index == 0) {
@@ -436,8 +1298,8 @@ pevent_t *pstate_header_file_handler(FILE *fd, int ch)
 
 pevent_t *pstate_reserve_keyword_handler(FILE *fd, int ch) 
 {
-    static char keyword[PEVENT_DATA_SIZE]; // Buffer to store the keyword
-    static int index = 0; // Current index in the keyword buffer
+    static __thread char keyword[PEVENT_DATA_SIZE]; // Buffer to store the keyword
+    static __thread int index = 0; // Current index in the keyword buffer
 
     // Check if the character is a valid part of a keyword (alphanumeric or underscore)
     if (isalnum(ch) || ch == '_') {
@@ -459,8 +1321,8 @@ pevent_t *pstate_reserve_keyword_handler(FILE *fd, int ch)
     index = 0; 
 
     // Check if the accumulated string is a reserved keyword
-    for (int i = 0; i < sizeof(res_kwords_data) / sizeof(res_kwords_data[0]); i++) {
-        if (strcmp(keyword, res_kwords_data[i]) == 0) {
+    for (int i = 0; *lang->keywords_data[i]; i++) {
+        if (strcmp(keyword, lang->keywords_data[i]) == 0) {
             // We found a reserved keyword
             pevent_data.type = PEVENT_RESERVE_KEYWORD; // Event type
             pevent_data.property = RES_KEYWORD_DATA; // Set the property type
@@ -491,8 +1353,8 @@ pevent_t *pstate_reserve_keyword_handler(FILE *fd, int ch)
 
 pevent_t *pstate_numeric_constant_handler(FILE *fd, int ch) 
 {
-    static char number[PEVENT_DATA_SIZE]; // Buffer to store the numeric constant
-    static int index = 0; // Current index in the number buffer
+    static __thread char number[PEVENT_DATA_SIZE]; // Buffer to store the numeric constant
+    static __thread int index = 0; // Current index in the number buffer
 
     // Check if the character is a digit or a decimal point
     if (isdigit(ch) || (ch == '.' && index > 0 && index < PEVENT_DATA_SIZE - 1 && strchr(number, '.') == NULL)) {
@@ -537,44 +1399,27 @@ pevent_t *pstate_numeric_constant_handler(FILE *fd, int ch)
 	 */
 //}
 
-pevent_t *pstate_string_handler(FILE *fd, int ch) 
+/* collects a string up to its closing quote, a backslash escapes the next
+ * char (e.g. the quote)
+ */
+pevent_t * pstate_string_handler(FILE *fd, int ch)
 {
-    static char str_buffer[PEVENT_DATA_SIZE]; // Buffer to store the string
-    static int index = 0; // Current index in the string buffer
-    int is_escaped = 0; // Flag to check if the previous character was an escape character
-
-    // Check if the character is the end quote of the string
-    if (ch == '"' && !is_escaped) {
-        // Null-terminate the string
-        str_buffer[index] = '\0';
-
-        // Reset index for the next string
-        index = 0;
-
-        // Populate the pevent_t structure with the string
-        pevent_data.type = PEVENT_STRING; // Event type
-        pevent_data.property = RES_KEYWORD_DATA; // Set the property if needed
-        pevent_data.length = strlen(str_buffer); // Set the length of the string
-        strncpy(pevent_data.data, str_buffer, PEVENT_DATA_SIZE - 1); // Copy the string into event data
-
-        return &pevent_data; // Return the populated event
-    }
-
-    // Check for escape character
-    if (ch == '\\' && !is_escaped) {
-        is_escaped = 1; // Set the escape flag
-        return NULL; // Continue reading characters
-    }
-
-    // Add the character to the string buffer if there's space
-    if (index < PEVENT_DATA_SIZE - 1) {
-        str_buffer[index++] = ch; // Add character to the buffer
-        is_escaped = 0; // Reset escape flag
-    } else {
-        // Handle buffer overflow (you can add error handling)
-    }
+	pevent_data.data[event_data_idx++] = ch;
+	if(literal_escape)
+	{
+		literal_escape = 0;
+	}
+	else if(ch == '\\')
+	{
+		literal_escape = 1;
+	}
+	else if(ch == literal_quote || (ch == '\n' && state == PSTATE_ASCII_CHAR)) // char constants never span lines
+	{
+		set_parser_event(PSTATE_IDLE, (state == PSTATE_STRING) ? PEVENT_STRING : PEVENT_ASCII_CHAR);
+		return &pevent_data;
+	}
 
-    return NULL; // Continue reading until end of string is detected
+	return NULL;
 }
 
 
@@ -607,42 +1452,155 @@ pevent_t * pstate_single_line_comment_handler(FILE *fd, int ch)
 pevent_t * pstate_multi_line_comment_handler(FILE *fd, int ch)
 {
 	int pre_ch;
-	switch(ch)
+	if(ch == lang->block_close[0]) /* comment might end here */
 	{
-		case '*' : /* comment might end here */
+		pre_ch = ch;
+		pevent_data.data[event_data_idx++] = ch;
+		pp_track(ch = fgetc(fd));
+		if(ch == lang->block_close[1])
+		{
+#ifdef DEBUG	
+			printf("\nMulti line comment End : %s\n", lang->block_close);
+#endif
 			pre_ch = ch;
 			pevent_data.data[event_data_idx++] = ch;
-			if((ch = fgetc(fd)) == '/')
+			set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
+			return &pevent_data;
+		}
+		else // multi line comment string still continued
+		{
+			pevent_data.data[event_data_idx++] = ch;
+		}
+	}
+	else if(ch == lang->block_close[1])
+	{
+		/* previous char of the comment, kept instead of seeking back to it */
+		pre_ch = comment_prev;
+
+		pevent_data.data[event_data_idx++] = ch;
+		if(pre_ch == lang->block_close[0])
+		{
+			set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
+			return &pevent_data;
+		}
+	}
+	else // collect multi-line comment chars
+	{
+		pevent_data.data[event_data_idx++] = ch;
+	}
+	comment_prev = ch;
+
+	return NULL;
+}
+
+/* collects an inactive conditional branch as it is, up to the #elif, #else
+ * or #endif closing it. Directives in comments, literals and nested
+ * conditionals of the region do not end it.
+ */
+pevent_t * pstate_inactive_region_handler(FILE *fd, int ch)
+{
+	char raw[PP_LINE_SIZE], clean[PP_LINE_SIZE], name[PP_NAME_SIZE];
+	pp_expr_t expr = { clean, 0 };
+	int prev = pp_skip_prev;
+	pp_dir_e kind = PP_DIR_OTHER;
+	long start;
+
+	pp_skip_prev = ch;
+	switch(pp_skip_in)
+	{
+		case '*' : // block comment
+			if(prev == lang->block_close[0] && ch == lang->block_close[1])
 			{
-#ifdef DEBUG	
-				printf("\nMulti line comment End : */\n");
-#endif
-				pre_ch = ch;
-				pevent_data.data[event_data_idx++] = ch;
-				set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
-				return &pevent_data;
+				pp_skip_in = 0;
+				pp_skip_prev = 0;
 			}
-			else // multi line comment string still continued
+			break;
+		case '/' : // line comment
+			if(ch == '\n')
+				pp_skip_in = 0;
+			break;
+		case '\"' :
+		case '\'' : // literal, also ends at the line end (e.g. an apostrophe in a note)
+			if(prev == '\\')
+				pp_skip_prev = 0; // escaped char
+			else if(ch == pp_skip_in || ch == '\n')
+				pp_skip_in = 0;
+			break;
+		default :
+			if(prev == lang->block_open[0] && ch == lang->block_open[1])
 			{
-				pevent_data.data[event_data_idx++] = ch;
+				pp_skip_in = '*';
+				pp_skip_prev = 0;
 			}
-			break;
-		case '/' :
-			/* go back by two steps and read previous char */
-			fseek(fd, -2L, SEEK_CUR); // move two steps back
-			pre_ch = fgetc(fd); // read a char
-			fgetc(fd); // to come back to current offset
-
-			pevent_data.data[event_data_idx++] = ch;
-			if(pre_ch == '*')
+			else if(prev == lang->line_comment[0] && ch == lang->line_comment[1])
 			{
-				set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
-				return &pevent_data;
+				pp_skip_in = '/';
+			}
+			else if(ch == '\"' || ch == '\'')
+			{
+				pp_skip_in = ch;
+			}
+			else if(lang->classes[(unsigned char)ch] == LANG_CC_PREPROCESSOR && pp_line_start)
+			{
+				start = ftell(fd);
+				pp_read_line(fd, raw, clean);
+				if(pp_name(&expr, name))
+					kind = pp_directive_kind(name);
+				fseek(fd, start, SEEK_SET);
+
+				if(kind == PP_DIR_IF || kind == PP_DIR_IFDEF || kind == PP_DIR_IFNDEF)
+				{
+					pp_skip_nest++;
+				}
+				else if(kind == PP_DIR_ENDIF && pp_skip_nest > 0)
+				{
+					pp_skip_nest--;
+				}
+				else if(kind != PP_DIR_OTHER && kind != PP_DIR_DEFINE && kind != PP_DIR_UNDEF)
+				{
+					/* region ends before this line, the idle state handles the directive */
+					fseek(fd, start - 1, SEEK_SET);
+					pp_line_blank = 1;
+					if(event_data_idx == 0)
+					{
+						state = PSTATE_IDLE;
+						return NULL;
+					}
+					set_parser_event(PSTATE_IDLE, PEVENT_INACTIVE_REGION);
+					return &pevent_data;
+				}
 			}
 			break;
-		default :  // collect multi-line comment chars
-			pevent_data.data[event_data_idx++] = ch;
-			break;
+	}
+
+	pevent_data.data[event_data_idx++] = ch;
+
+	return NULL;
+}
+/* collects a raw string (Go '`...`') up to its closing quote, it has no
+ * escapes and may span lines
+ */
+pevent_t * pstate_raw_string_handler(FILE *fd, int ch)
+{
+	pevent_data.data[event_data_idx++] = ch;
+	if(lang->classes[(unsigned char)ch] == LANG_CC_RAW_STRING)
+	{
+		set_parser_event(PSTATE_IDLE, PEVENT_STRING);
+		return &pevent_data;
+	}
+
+	return NULL;
+}
+/* collects the rest of a conditional directive line longer than one event,
+ * the state after the line was decided by pp_directive
+ */
+pevent_t * pstate_directive_line_handler(FILE *fd, int ch)
+{
+	pevent_data.data[event_data_idx++] = ch;
+	if(--pp_line_left == 0)
+	{
+		set_parser_event(pp_line_next, PEVENT_PREPROCESSOR_DIRECTIVE);
+		return &pevent_data;
 	}
 
 	return NULL;
@@ -655,22 +1613,10 @@ pevent_t * pstate_multi_line_comment_handler(FILE *fd, int ch)
 	 */
 //}
 
-pevent_t *pstate_ascii_char_handler(FILE *fd, int ch) {
-    // Check if the character is a valid ASCII character
-    if (ch >= 0 && ch <= 127) {
-        // Populate the pevent_t structure
-        pevent_data.type = PEVENT_ASCII_CHAR;  // Set the event type
-        pevent_data.property = RES_KEYWORD_DATA; // You can set this based on context
-        pevent_data.length = 1;  // Length is 1 since we are handling a single character
-        pevent_data.data[0] = (char)ch;  // Store the ASCII character in the data array
-        pevent_data.data[1] = '\0';  // Null-terminate the string for safety
-
-        return &pevent_data;  // Return the populated event
-    }
-
-    return NULL;  // Return NULL if the character is not a valid ASCII character
+/* collects a char constant, the same way as a string */
+pevent_t * pstate_ascii_char_handler(FILE *fd, int ch)
+{
+	return pstate_string_handler(fd, ch);
 }
 
-
-
 /**** End of file ****/
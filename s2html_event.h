@@ -5,27 +5,42 @@
  * It supports events like preprocessor directives, keywords, constants, strings, and comments.
  *
  * Constants:
- * - Event types and the maximum size for event data.
+ * - Event types, the maximum size for event data and the number of macros (add_parser_macro).
  *
  * Enum (pevent_e):
- * - Defines various event types the parser can detect.
+ * - Defines various event types the parser can detect. PEVENT_INACTIVE_REGION is the raw
+ *   text of a conditional branch (#if 0, #ifdef of an undefined macro, ...) which is not
+ *   compiled; a long region is handed out in several consecutive events.
  *
  * Structure (pevent_t):
  * - Holds event details such as type, properties, and content.
  *
+ * Structure (ptoken_t):
+ * - A stored copy of an event, kept in an arena (see s2html_arena.h) for look-ahead
+ *   or whole-file token streams.
+ *
  * Functions:
  * - get_parser_event: Fetches the next event from the file.
+ * - pevent_store: Copies an event into an arena.
+ * - get_parser_tokens: Parses the next chunk of tokens (or the whole file) into a token stream
+ *   stored in an arena.
+ * - set_parser_language: Sets the language (see s2html_lang.h) of the next file parsed.
+ * - add_parser_macro: Defines a macro ("NAME" or "NAME=VALUE") for evaluating conditionals.
  */
 
 #ifndef S2HTML_EVENT_H
 #define S2HTML_EVENT_H
 
+#include "s2html_arena.h"
+#include "s2html_lang.h"
+
 #define USER_HEADER_FILE		1
 #define STD_HEADER_FILE			2
 #define RES_KEYWORD_DATA		3
 #define RES_KEYWORD_NON_DATA	4
 
 #define PEVENT_DATA_SIZE	1024
+#define PEVENT_MAX_MACROS	64
 
 typedef enum
 {
@@ -39,6 +54,7 @@ typedef enum
 	PEVENT_SINGLE_LINE_COMMENT,
 	PEVENT_MULTI_LINE_COMMENT,
 	PEVENT_ASCII_CHAR,
+	PEVENT_INACTIVE_REGION,
 	PEVENT_EOF
 } pevent_e;
 
@@ -50,9 +66,22 @@ typedef struct
 	char data[PEVENT_DATA_SIZE];  // parsed string data
 } pevent_t;
 
+typedef struct ptoken
+{
+	pevent_e type;       // event type
+	int property;        // property associated with data
+	int length;          // data length
+	char *data;          // parsed string data, stored in the arena
+	struct ptoken *next; // next token of the stream
+} ptoken_t;
+
 /********** function prototypes **********/
 
 pevent_t *get_parser_event(FILE *fp);
+ptoken_t *pevent_store(arena_t *arena, pevent_t *event);
+ptoken_t *get_parser_tokens(FILE *fp, arena_t *arena, int max_tokens, int *at_eof);
+void set_parser_language(const lang_t *language);
+int add_parser_macro(const char *definition);
 
 #endif
 /**** End of file ****/
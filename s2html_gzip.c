@@ -0,0 +1,268 @@
+/*
+ * Compressed Output Functions
+ *
+ * This file implements a write-only FILE stream which gzip compresses
+ * everything written to it, so the HTML writer can produce a .html.gz
+ * file directly without an intermediate uncompressed file.
+ *
+ * Data is collected into blocks of GZ_BLOCK_SIZE bytes. Once one block per
+ * thread is filled, all of them are compressed in parallel and written out in
+ * order. Every block is raw deflate data ending on a byte boundary (a sync
+ * flush, the last block of the stream finishes it instead), so the blocks
+ * simply follow each other inside one gzip member: the header is written on
+ * open, the trailer on close with the CRC of the whole stream combined from
+ * the CRCs of the blocks (crc32_combine). The compression threads are a
+ * batch pool started with the stream and kept until it is closed, so a round
+ * costs no thread creation.
+ *
+ * Main features:
+ * - gzip_fopen: Opens the compressed stream (fopencookie based).
+ * - gz_write / gz_close: Stream callbacks collecting and flushing blocks.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "s2html_gzip.h"
+#include "s2html_batch.h"
+
+/* gzip member header: magic, deflate, no flags, no time, no extra flags, Unix */
+static const unsigned char gz_member_header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+
+/* one independently compressed block */
+typedef struct
+{
+    unsigned char *in;     // uncompressed data
+    size_t in_len;         // bytes used in 'in'
+    unsigned char *out;    // compressed (raw deflate) data
+    size_t out_len;        // bytes used in 'out'
+    size_t out_size;       // capacity of 'out'
+    uLong crc;             // CRC-32 of 'in'
+    int last;              // last block of the stream, finishes the deflate data
+    int status;            // 0 on success, -1 if compression failed
+} gz_block_t;
+
+/* state behind one compressed stream */
+typedef struct
+{
+    FILE *fp;              // underlying output file
+    gz_block_t *blocks;    // one block per thread
+    batch_pool_t *pool;    // compression threads, NULL for a single thread
+    int nblocks;           // number of blocks compressed per round
+    int used;              // blocks completely filled in this round
+    uLong crc;             // CRC-32 of the data written so far
+    uLong total;           // bytes written so far (modulo 2^32 in the trailer)
+} gz_writer_t;
+
+/********** Utility functions **********/
+
+/* compresses one block into raw deflate data which continues the
+ * previous blocks, and computes its CRC
+ */
+static void gz_compress_block(gz_block_t *blk)
+{
+    z_stream strm;
+    int ret;
+
+    memset(&strm, 0, sizeof(strm));
+    blk->status = -1;
+    blk->crc = crc32(crc32(0L, Z_NULL, 0), blk->in, blk->in_len);
+    /* negative windowBits: raw deflate, the gzip wrapper is written by the stream */
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    strm.next_in = blk->in;
+    strm.avail_in = blk->in_len;
+    strm.next_out = blk->out;
+    strm.avail_out = blk->out_size;
+
+    /* a sync flush ends on a byte boundary without ending the deflate data */
+    ret = deflate(&strm, blk->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (blk->last ? ret == Z_STREAM_END : (ret == Z_OK && strm.avail_in == 0 && strm.avail_out > 0))
+    {
+        blk->out_len = blk->out_size - strm.avail_out;
+        blk->status = 0;
+    }
+    deflateEnd(&strm);
+}
+
+/* compresses block 'item' of a round (pool callback) */
+static void gz_compress_work(void *arg, int worker, int item)
+{
+    gz_writer_t *gz = arg;
+
+    (void)worker;
+    gz_compress_block(&gz->blocks[item]);
+}
+
+/* compresses the first 'count' blocks in parallel and writes them in order */
+static int gz_flush_round(gz_writer_t *gz, int count)
+{
+    int idx, ret = 0;
+
+    /* the calling thread compresses blocks too */
+    if (gz->pool != NULL)
+        batch_pool_run(gz->pool, count, gz_compress_work, gz);
+    else
+        gz_compress_block(&gz->blocks[0]);
+
+    for (idx = 0; idx < count; idx++)
+    {
+        gz_block_t *blk = &gz->blocks[idx];
+
+        if (blk->status != 0 || fwrite(blk->out, 1, blk->out_len, gz->fp) != blk->out_len)
+            ret = -1;
+        gz->crc = crc32_combine(gz->crc, blk->crc, blk->in_len);
+        gz->total += blk->in_len;
+        blk->in_len = 0;
+    }
+    gz->used = 0;
+
+    return ret;
+}
+
+/* releases all memory owned by the writer */
+static void gz_free(gz_writer_t *gz)
+{
+    int idx;
+
+    batch_pool_destroy(gz->pool);
+    for (idx = 0; idx < gz->nblocks; idx++)
+    {
+        free(gz->blocks[idx].in);
+        free(gz->blocks[idx].out);
+    }
+    free(gz->blocks);
+    free(gz);
+}
+
+/********** Stream callbacks **********/
+
+/* collects written data into blocks, compressing each full round */
+static ssize_t gz_write(void *cookie, const char *buf, size_t size)
+{
+    gz_writer_t *gz = cookie;
+    size_t total = size;
+
+    while (size > 0)
+    {
+        gz_block_t *blk = &gz->blocks[gz->used];
+        size_t n = GZ_BLOCK_SIZE - blk->in_len;
+
+        if (n > size)
+            n = size;
+        memcpy(blk->in + blk->in_len, buf, n);
+        blk->in_len += n;
+        buf += n;
+        size -= n;
+
+        if (blk->in_len == GZ_BLOCK_SIZE && ++gz->used == gz->nblocks)
+        {
+            if (gz_flush_round(gz, gz->nblocks) != 0)
+                return -1;
+        }
+    }
+
+    return total;
+}
+
+/* compresses the remaining data, writes the gzip trailer and closes the
+ * underlying file
+ */
+static int gz_close(void *cookie)
+{
+    gz_writer_t *gz = cookie;
+    unsigned char trailer[8];
+    int count = gz->used + 1;
+    int idx, ret = 0;
+
+    /* the partially filled (maybe empty) block finishes the deflate data */
+    gz->blocks[gz->used].last = 1;
+    if (gz_flush_round(gz, count) != 0)
+        ret = -1;
+
+    /* CRC-32 and length of the uncompressed data, little endian */
+    for (idx = 0; idx < 4; idx++)
+    {
+        trailer[idx] = (gz->crc >> (8 * idx)) & 0xff;
+        trailer[4 + idx] = (gz->total >> (8 * idx)) & 0xff;
+    }
+    if (fwrite(trailer, 1, sizeof(trailer), gz->fp) != sizeof(trailer))
+        ret = -1;
+
+    if (fclose(gz->fp) != 0)
+        ret = -1;
+    gz_free(gz);
+
+    return ret == 0 ? 0 : EOF;
+}
+
+/************ Compressed stream functions **********/
+
+/* Opens 'path' for writing and returns a stream which gzip compresses
+ * everything written to it using up to 'threads' parallel blocks.
+ * Returns NULL if the file or the buffers could not be created.
+ */
+FILE *gzip_fopen(const char *path, int threads)
+{
+    cookie_io_functions_t io = { NULL, gz_write, NULL, gz_close };
+    gz_writer_t *gz;
+    FILE *fp;
+    int idx;
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > GZ_MAX_THREADS)
+        threads = GZ_MAX_THREADS;
+
+    if (NULL == (gz = calloc(1, sizeof(*gz))))
+        return NULL;
+    gz->nblocks = threads;
+    if (NULL == (gz->blocks = calloc(threads, sizeof(gz_block_t))))
+    {
+        free(gz);
+        return NULL;
+    }
+
+    for (idx = 0; idx < threads; idx++)
+    {
+        gz_block_t *blk = &gz->blocks[idx];
+
+        /* deflateBound() of the default settings plus room for the flush marker */
+        blk->out_size = compressBound(GZ_BLOCK_SIZE) + 32;
+        blk->in = malloc(GZ_BLOCK_SIZE);
+        blk->out = malloc(blk->out_size);
+        if (blk->in == NULL || blk->out == NULL)
+        {
+            gz_free(gz);
+            return NULL;
+        }
+    }
+
+    if (threads > 1 && NULL == (gz->pool = batch_pool_create(threads)))
+    {
+        gz_free(gz);
+        return NULL;
+    }
+
+    if (NULL == (gz->fp = fopen(path, "wb")))
+    {
+        gz_free(gz);
+        return NULL;
+    }
+    gz->crc = crc32(0L, Z_NULL, 0);
+    fwrite(gz_member_header, 1, sizeof(gz_member_header), gz->fp); // a failure shows up on close
+
+    if (NULL == (fp = fopencookie(gz, "w", io)))
+    {
+        fclose(gz->fp);
+        gz_free(gz);
+        return NULL;
+    }
+
+    return fp;
+}
+
+/**** End of file ****/
@@ -0,0 +1,28 @@
+/*
+ * Header for compressed (gzip) HTML output.
+ *
+ * The output is split into independent blocks which are compressed in
+ * parallel (pigz style) and written in order as the deflate data of a single
+ * gzip member, so the resulting file can be served or decompressed with any
+ * gzip tool.
+ *
+ * Constants:
+ * - GZ_BLOCK_SIZE: Uncompressed size of one independently compressed block.
+ * - GZ_MAX_THREADS: Upper limit for blocks compressed at the same time.
+ *
+ * Functions:
+ * - gzip_fopen: Opens a compressed output file as a regular FILE stream.
+ */
+
+#ifndef S2HTML_GZIP_H
+#define S2HTML_GZIP_H
+
+#define GZ_BLOCK_SIZE	(128 * 1024)
+#define GZ_MAX_THREADS	32
+
+/********** function prototypes **********/
+
+FILE *gzip_fopen(const char *path, int threads); // Opens path for writing, everything written to the stream is gzip compressed.
+
+#endif
+/**** End of file ****/
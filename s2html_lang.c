@@ -0,0 +1,184 @@
+/*
+ * Language Definitions
+ *
+ * This file defines the languages known to the lexer: C, C++, Go and shell
+ * scripts. Each definition is a constant with its keyword lists, comment
+ * delimiters and byte class table, so adding a language means adding one
+ * definition here and its extensions.
+ *
+ * Main features:
+ * - lang_c / lang_cpp / lang_go / lang_shell: The language definitions.
+ * - lang_for_path: Chooses the language by file extension.
+ * - lang_comment_starts: One char line comments (shell '#') only start a word.
+*/
+
+#include <string.h>
+#include <ctype.h>
+#include "s2html_lang.h"
+
+/* byte classes shared by all languages: numbers and (lower case) keywords */
+#define LANG_CLASSES_COMMON \
+	['0' ... '9'] = LANG_CC_DIGIT, \
+	['a' ... 'z'] = LANG_CC_WORD
+
+/* C family: // and block comments, strings and character constants */
+#define LANG_CLASSES_C_FAMILY \
+	LANG_CLASSES_COMMON, \
+	['/']  = LANG_CC_COMMENT, \
+	['"']  = LANG_CC_STRING, \
+	['\''] = LANG_CC_CHAR
+
+/********** C **********/
+
+static const char *const c_extensions[] = { ".c", ".h", NULL };
+
+static const char *const c_kwords_data[] = {"const", "volatile", "extern", "auto", "register",
+											"static", "signed", "unsigned", "short", "long",
+											"double", "char", "int", "float", "struct",
+											"union", "enum", "void", "typedef", ""
+										   };
+
+static const char *const c_kwords_non_data[] = {"goto", "return", "continue", "break",
+												"if", "else", "for", "while", "do",
+												"switch", "case", "default", "sizeof", ""
+											   };
+
+const lang_t lang_c = {
+	.name = "c",
+	.extensions = c_extensions,
+	.keywords_data = c_kwords_data,
+	.keywords_non_data = c_kwords_non_data,
+	.line_comment = "//",
+	.block_open = "/*",
+	.block_close = "*/",
+	.classes = { LANG_CLASSES_C_FAMILY, ['#'] = LANG_CC_PREPROCESSOR },
+};
+
+/********** C++ **********/
+
+static const char *const cpp_extensions[] = { ".cc", ".cpp", ".cxx", ".c++", ".C",
+											  ".hh", ".hpp", ".hxx", ".h++", ".H", NULL };
+
+static const char *const cpp_kwords_data[] = {"const", "volatile", "extern", "auto", "register",
+											  "static", "signed", "unsigned", "short", "long",
+											  "double", "char", "int", "float", "struct",
+											  "union", "enum", "void", "typedef", "bool",
+											  "class", "namespace", "template", "typename", "using",
+											  "mutable", "explicit", "inline", "virtual", "friend",
+											  "constexpr", "wchar_t", "char16_t", "char32_t", ""
+											 };
+
+static const char *const cpp_kwords_non_data[] = {"goto", "return", "continue", "break",
+												  "if", "else", "for", "while", "do",
+												  "switch", "case", "default", "sizeof",
+												  "new", "delete", "this", "throw", "try", "catch",
+												  "public", "private", "protected", "operator",
+												  "true", "false", "nullptr", "static_cast",
+												  "dynamic_cast", "const_cast", "reinterpret_cast", ""
+												 };
+
+const lang_t lang_cpp = {
+	.name = "c++",
+	.extensions = cpp_extensions,
+	.keywords_data = cpp_kwords_data,
+	.keywords_non_data = cpp_kwords_non_data,
+	.line_comment = "//",
+	.block_open = "/*",
+	.block_close = "*/",
+	.classes = { LANG_CLASSES_C_FAMILY, ['#'] = LANG_CC_PREPROCESSOR },
+};
+
+/********** Go **********/
+
+static const char *const go_extensions[] = { ".go", NULL };
+
+static const char *const go_kwords_data[] = {"var", "const", "type", "struct", "interface",
+											 "map", "chan", "func", "bool", "byte", "rune",
+											 "string", "int", "int8", "int16", "int32", "int64",
+											 "uint", "uint8", "uint16", "uint32", "uint64", "uintptr",
+											 "float32", "float64", "complex64", "complex128", "error", ""
+											};
+
+static const char *const go_kwords_non_data[] = {"package", "import", "return", "continue", "break",
+												 "if", "else", "for", "range", "switch", "case",
+												 "default", "select", "go", "defer", "goto",
+												 "fallthrough", "nil", "true", "false", ""
+												};
+
+/* no preprocessor, raw strings in back quotes */
+const lang_t lang_go = {
+	.name = "go",
+	.extensions = go_extensions,
+	.keywords_data = go_kwords_data,
+	.keywords_non_data = go_kwords_non_data,
+	.line_comment = "//",
+	.block_open = "/*",
+	.block_close = "*/",
+	.classes = { LANG_CLASSES_C_FAMILY, ['`'] = LANG_CC_RAW_STRING },
+};
+
+/********** Shell **********/
+
+static const char *const shell_extensions[] = { ".sh", ".bash", ".ksh", ".zsh", NULL };
+
+static const char *const shell_kwords_data[] = {"local", "export", "readonly", "declare",
+												"typeset", "unset", ""
+											   };
+
+static const char *const shell_kwords_non_data[] = {"if", "then", "else", "elif", "fi",
+													"for", "while", "until", "do", "done",
+													"case", "esac", "in", "function", "select",
+													"return", "break", "continue", "exit", ""
+												   };
+
+/* # comments only, both quotes start strings */
+const lang_t lang_shell = {
+	.name = "shell",
+	.extensions = shell_extensions,
+	.keywords_data = shell_kwords_data,
+	.keywords_non_data = shell_kwords_non_data,
+	.line_comment = "#",
+	.block_open = "",
+	.block_close = "",
+	.classes = { LANG_CLASSES_COMMON, ['#'] = LANG_CC_COMMENT, ['"'] = LANG_CC_STRING, ['\''] = LANG_CC_STRING },
+};
+
+static const lang_t *const languages[] = { &lang_c, &lang_cpp, &lang_go, &lang_shell, NULL };
+
+/************ Language functions **********/
+
+/* Returns the language of the file at 'path' by its extension, C if unknown. */
+const lang_t *lang_for_path(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	int idx, ext_idx;
+
+	if(ext == NULL || strchr(ext, '/') != NULL)
+		return &lang_c;
+
+	for(idx = 0; languages[idx] != NULL; idx++)
+	{
+		for(ext_idx = 0; languages[idx]->extensions[ext_idx] != NULL; ext_idx++)
+		{
+			if(strcmp(languages[idx]->extensions[ext_idx], ext) == 0)
+				return languages[idx];
+		}
+	}
+
+	return &lang_c;
+}
+
+/* Tells whether the line comment delimiter of 'lang' read after the byte
+ * 'prev' starts a comment. A two char delimiter always does, a one char
+ * delimiter (shell '#') only at the start of a word, e.g. not in $# or
+ * ${#name}.
+ */
+int lang_comment_starts(const lang_t *lang, int prev)
+{
+	if(lang->line_comment[1] != '\0')
+		return 1;
+
+	return prev == '\n' || isspace(prev) || (prev && strchr(";&|()", prev));
+}
+
+/**** End of file ****/
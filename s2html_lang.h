@@ -0,0 +1,59 @@
+/*
+ * Header for the language definitions of the lexer.
+ *
+ * A language definition holds everything the lexer needs to know about a
+ * language: its keywords, comment delimiters and a table with the class of
+ * every byte (comment start, string or character quote, preprocessor, ...).
+ * The definitions are static initializers, so the tables are built by the
+ * compiler and the lexer only indexes them. The language of a file is chosen
+ * by its extension.
+ *
+ * Enum (lang_class_e):
+ * - Byte classes of the lexer's idle state.
+ *
+ * Structure (lang_t):
+ * - A language definition.
+ *
+ * Functions:
+ * - lang_for_path: Returns the language of a file (C if the extension is unknown).
+ * - lang_comment_starts: Tells whether a line comment delimiter read after a byte starts a comment.
+ */
+
+#ifndef S2HTML_LANG_H
+#define S2HTML_LANG_H
+
+#define LANG_DELIM_SIZE		3
+
+typedef enum
+{
+	LANG_CC_TEXT,            // plain text, collected as it is
+	LANG_CC_COMMENT,         // first char of a comment delimiter
+	LANG_CC_PREPROCESSOR,    // starts a preprocessor directive
+	LANG_CC_STRING,          // string quote
+	LANG_CC_RAW_STRING,      // raw string quote, no escapes and no comments inside (Go '`')
+	LANG_CC_CHAR,            // character quote
+	LANG_CC_DIGIT,           // starts a numeric constant
+	LANG_CC_WORD             // may start a keyword
+} lang_class_e;
+
+typedef struct
+{
+	const char *name;
+	const char *const *extensions;         // file name endings, NULL terminated
+	const char *const *keywords_data;      // data type keywords, "" terminated
+	const char *const *keywords_non_data;  // other keywords, "" terminated
+	char line_comment[LANG_DELIM_SIZE];    // e.g. "//" or "#"
+	char block_open[LANG_DELIM_SIZE];      // e.g. "/*", empty if none
+	char block_close[LANG_DELIM_SIZE];     // e.g. "*/", empty if none
+	unsigned char classes[256];            // lang_class_e of every byte
+} lang_t;
+
+extern const lang_t lang_c, lang_cpp, lang_go, lang_shell;
+
+/********** function prototypes **********/
+
+const lang_t *lang_for_path(const char *path);
+int lang_comment_starts(const lang_t *lang, int prev);
+
+#endif
+/**** End of file ****/
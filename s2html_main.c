@@ -11,78 +11,907 @@
  * - get_parser_event: Retrieves the next parsing event from the source file.
  * - source_to_html: Converts parsed source code events into HTML and writes to the destination file.
  *
+ * Character Set:
+ * - Source files are validated as UTF-8 before parsing. Invalid sequences (e.g. stray Latin-1
+ *   bytes) are replaced with U+FFFD in a repaired in-memory copy and their count is reported.
+ *
  * Error Handling:
  * - The program verifies the existence of the source file and the ability to create the output file.
  * - It checks if the correct arguments are provided for input and output file handling.
 */
 
 #include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "s2html_event.h"
+#include "s2html_theme.h"
 #include "s2html_conv.h"
+#include "s2html_gzip.h"
+#include "s2html_utf8.h"
+#include "s2html_batch.h"
+#include "s2html_stats.h"
+#include "s2html_watch.h"
+#include "s2html_shard.h"
+#include "s2html_trace.h"
+#include "s2html_aio.h"
+#include "s2html_mapout.h"
 
-int main (int argc, char *argv[])
+/* files and per worker counts of an analytics run */
+typedef struct
+{
+    char **files;
+    stats_t *stats;
+    int *status;       // per file result, may be NULL
+} stats_job_t;
+
+/* Lexes one file of an analytics run into the counts of its worker. */
+static void stats_work(void *arg, int worker, int item)
+{
+    stats_job_t *job = arg;
+    trace_span_t span;
+    int ret;
+
+    TRACE_BEGIN(span, "scan", job->files[item]);
+    ret = stats_scan_file(&job->stats[worker], job->files[item]);
+    TRACE_END(span);
+
+    if (ret != 0)
+        fprintf(stderr, "Error!!! File %s Could Not Be Opened\n", job->files[item]);
+    if (job->status)
+        job->status[item] = ret ? 2 : 0; // same exit code as a failed conversion
+}
+
+/* Lexes all files in parallel and returns their merged counts, NULL if out
+ * of memory. The result of each file is stored in status (if not NULL).
+ * The returned counts must be freed by the caller.
+ */
+static stats_t *collect_stats(char **files, int nfiles, int *status)
+{
+    stats_job_t job;
+    int workers = batch_workers(), idx;
+
+    job.files = files;
+    job.status = status;
+    if (NULL == (job.stats = malloc(workers * sizeof(stats_t))))
+    {
+        printf("Error!!! Out Of Memory\n");
+        return NULL;
+    }
+    for (idx = 0; idx < workers; idx++)
+        stats_init(&job.stats[idx]);
+
+    workers = batch_run(nfiles, workers, stats_work, &job);
+
+    for (idx = 1; idx < workers; idx++)
+        stats_merge(&job.stats[0], &job.stats[idx]);
+
+    return job.stats;
+}
+
+/* Analytics mode: lexes all files in parallel and prints the merged report. */
+static int run_stats(char **files, int nfiles)
+{
+    stats_t *st;
+    int ret;
+
+    if (NULL == (st = collect_stats(files, nfiles, NULL)))
+        return 5;
+
+    stats_print(stdout, st);
+    ret = st->failed ? 2 : 0;
+    free(st);
+
+    return ret;
+}
+
+/* Writes the compact mode stylesheet into the directory of the output file. */
+static int write_compact_styles(const char *dest_file)
+{
+    char css_file[FILENAME_MAX];
+    const char *slash = strrchr(dest_file, '/');
+    int dir_len = slash ? (int)(slash - dest_file + 1) : 0;
+    FILE *css_fp;
+
+    snprintf(css_file, sizeof(css_file), "%.*s%s", dir_len, dest_file, HTML_COMPACT_STYLES);
+    if (NULL == (css_fp = fopen(css_file, "w")))
+    {
+        printf("Error!!! Could Not Create %s Style File\n", css_file);
+        return -1;
+    }
+    html_write_styles(css_fp);
+
+    return fclose(css_fp);
+}
+
+/* checks whether two files are in the same directory */
+static int same_dir(const char *file1, const char *file2)
+{
+    const char *slash1 = strrchr(file1, '/'), *slash2 = strrchr(file2, '/');
+    size_t len1 = slash1 ? (size_t)(slash1 - file1) : 0;
+    size_t len2 = slash2 ? (size_t)(slash2 - file2) : 0;
+
+    return len1 == len2 && strncmp(file1, file2, len1) == 0;
+}
+
+/* events lexed (and then rendered) at a time when tracing */
+#define CONVERT_CHUNK_TOKENS	1024
+
+/* files converted per window of a batched I/O run */
+#define CONVERT_WINDOW_FILES	AIO_RING_DEPTH
+
+/* output options shared by all conversions */
+static int compress = 0;     // -z : write gzip compressed output
+static int gzip_threads = 1; // blocks compressed in parallel per compressed output
+static aio_backend_e io_backend = AIO_BACKEND_URING; // --io : batched I/O of batch conversions
+static batch_pool_t *convert_pool = NULL; // workers kept between watch mode bursts
+
+/* Converts an opened source into HTML written to out, the language is chosen
+ * by the extension of src_file. Returns 0 on success or 5 if out of memory.
+ */
+static int convert_stream(const char *src_file, FILE *sfp, html_out_t *out)
 {
-    FILE *sfp, *dfp; // source and destination file descriptors 
     pevent_t *event;
-    char dest_file[100];
+    ptoken_t *tokens;
+    arena_t *arena;
+    trace_span_t span;
+    int at_eof, ret;
 
-    // Check if file name is provided
-    if(argc < 2)
+    set_parser_language(lang_for_path(src_file));
+
+    // Write HTML starting tags
+    html_begin(out, HTML_OPEN);
+
+    // Read source file, convert to HTML, and write to destination file
+    if (!trace_enabled)
     {
-        printf("\nError!!! Please Enter File Name And Mode\n");
-        printf("Usage: <executable> <file name> \n");
-        printf("Example_1 : ./a.out test.c\n\n");
-        printf("Example_2 : ./a.out test.txt\n\n");
-        return 1;
+        do
+        {
+            event = get_parser_event(sfp);
+            source_to_html(out, event);
+        } while (event->type != PEVENT_EOF);
+
+        html_end(out, HTML_CLOSE);
+        if (out->fp != NULL)
+            fflush(out->fp);
+        return 0;
     }
-    
+
+    // Traced: lex chunks of tokens into the arena and render each chunk, so
+    // the lex and render stages are separate spans
+    arena = arena_acquire();
+    ret = (arena == NULL) ? 5 : 0;
+    at_eof = (arena == NULL);
+    while (!at_eof)
+    {
+        TRACE_BEGIN(span, "lex", NULL);
+        tokens = get_parser_tokens(sfp, arena, CONVERT_CHUNK_TOKENS, &at_eof);
+        TRACE_END(span);
+
+        if (tokens == NULL)
+        {
+            ret = 5;
+            break;
+        }
+
+        TRACE_BEGIN(span, "render", NULL);
+        source_to_html_tokens(out, tokens);
+        TRACE_END(span);
+
+        arena_reset(arena);
+    }
+    arena_release(arena);
+
+    // Write HTML ending tags
+    TRACE_BEGIN(span, "flush", NULL);
+    html_end(out, HTML_CLOSE);
+    if (out->fp != NULL)
+        fflush(out->fp);
+    TRACE_END(span);
+
+    return ret;
+}
+
+/* Converts one source file into '<dest_prefix>.html' (or '.html.gz').
+ * Returns 0 on success or the program exit code of the failure.
+ */
+static int convert_file(const char *src_file, const char *dest_prefix)
+{
+    FILE *sfp, *dfp; // source and destination file descriptors 
+    utf8_source_t src;       // validated source, replaced UTF-8 sequences in src.invalid
+    mapout_t *mo = NULL;     // mapped output of a large source, dfp is NULL then
+    html_out_t out = { NULL };
+    char dest_file[FILENAME_MAX];
+    trace_span_t file_span, span;
+    int ret;
+
     #ifdef DEBUG
-    printf("File To Be Opened : %s\n", argv[1]);
+    printf("File To Be Opened : %s\n", src_file);
     #endif
 
+    TRACE_BEGIN(file_span, "convert", src_file);
+    TRACE_BEGIN(span, "open", src_file);
+
     // Open source file
-    if(NULL == (sfp = fopen(argv[1], "r")))
+    if(NULL == (sfp = utf8_source_open(&src, src_file)))
     {
-        printf("Error!!! File %s Could Not Be Opened\n", argv[1]);
+        printf("Error!!! File %s Could Not Be Opened\n", src_file);
+        TRACE_END(span);
+        TRACE_END(file_span);
         return 2;
     }
 
-    // Check for output file name, default to source file name with .html extension
-    if (argc > 2)
+    // Output file name is the prefix with .html extension
+    snprintf(dest_file, sizeof(dest_file), "%s.html%s", dest_prefix, compress ? ".gz" : "");
+
+    // Open destination file, large outputs are rendered into a mapping of the file
+    dfp = NULL;
+    if (compress)
+        dfp = gzip_fopen(dest_file, gzip_threads);
+    else if (src.len >= MAPOUT_MIN_INPUT)
+        mo = mapout_open(dest_file, src.len);
+    if (NULL == mo && !compress)
+        dfp = fopen(dest_file, "w");
+
+    if (NULL == dfp && NULL == mo)
     {
-        sprintf(dest_file, "%s.html", argv[2]);
+        printf("Error!!! Could Not Create %s Output File\n", dest_file);
+        utf8_source_close(&src, sfp);
+        TRACE_END(span);
+        TRACE_END(file_span);
+        return 3;
+    }
+    TRACE_END(span);
+
+    out.fp = dfp;
+    ret = convert_stream(src_file, sfp, mo != NULL ? &mo->out : &out);
+    
+    // Close files, compressed output is flushed on close so check it
+    TRACE_BEGIN(span, "close", dest_file);
+    utf8_source_close(&src, sfp);
+    if (mo != NULL)
+    {
+        if (mapout_close(mo) != 0 && ret == 0)
+            ret = 4;
     }
     else
     {
-        sprintf(dest_file, "%s.html", argv[1]);
+        if (ferror(dfp) && ret == 0)
+            ret = 4;
+        if (fclose(dfp) != 0 && ret == 0)
+            ret = 4;
     }
+    TRACE_END(span);
+    TRACE_END(file_span);
 
-    // Open destination file
-    if (NULL == (dfp = fopen(dest_file, "w")))
+    // A failed conversion leaves no partial or stale output behind
+    if (ret != 0)
     {
-        printf("Error!!! Could Not Create %s Output File\n", dest_file);
-        return 3;
+        remove(dest_file);
+        if (ret == 5)
+            printf("Error!!! Out Of Memory\n");
+        else
+            printf("Error!!! Could Not Write %s Output File\n", dest_file);
+        return ret;
     }
 
-    // Write HTML starting tags
-    html_begin(dfp, HTML_OPEN);
-
-    // Read source file, convert to HTML, and write to destination file
-    do
-    {
-        event = get_parser_event(sfp);
-        source_to_html(dfp, event);
-    } while (event->type != PEVENT_EOF);
+    if (src.invalid > 0)
+        printf("\nWarning!!! %zu Invalid UTF-8 Sequences In %s Replaced\n", src.invalid, src_file);
 
-    // Write HTML ending tags
-    html_end(dfp, HTML_CLOSE);
-    
     // Output success message
     printf("\nOutput File %s Generated\n\n", dest_file);
 
-    // Close files
-    fclose(sfp);
-    fclose(dfp);
+    return 0;
+}
+
+/* files of a batch conversion and their results */
+typedef struct
+{
+    char **files;
+    int *status;       // convert_file result per file, may be NULL
+} convert_job_t;
+
+/* Converts one file of a batch next to its source. */
+static void convert_work(void *arg, int worker, int item)
+{
+    convert_job_t *job = arg;
+    int ret;
+
+    (void)worker;
+    ret = convert_file(job->files[item], job->files[item]);
+    if (job->status)
+        job->status[item] = ret;
+}
+
+/* one window of files of a batched I/O run */
+typedef struct
+{
+    int nfiles;
+    int *status;                                  // results of the window's files, may be NULL
+    int result[CONVERT_WINDOW_FILES];             // convert_file result per file
+    aio_file_t src[CONVERT_WINDOW_FILES];         // sources, read by batched I/O
+    aio_file_t dest[CONVERT_WINDOW_FILES];        // converted output per file
+    aio_file_t writes[CONVERT_WINDOW_FILES];      // outputs to write, written by batched I/O
+    int write_item[CONVERT_WINDOW_FILES];         // file of each output to write
+    char dest_files[CONVERT_WINDOW_FILES][FILENAME_MAX];
+} convert_window_t;
+
+/* batched I/O running while a window is converted */
+typedef struct
+{
+    convert_window_t *write;   // converted window to write, may be NULL
+    convert_window_t *read;    // window to read next, may be NULL
+    char **files;              // files of the window to read
+    int nfiles;
+    int *status;
+} convert_io_t;
+
+/* Converts one file of a window from memory into memory. */
+static void convert_data_work(void *arg, int worker, int item)
+{
+    convert_window_t *win = arg;
+    aio_file_t *src = &win->src[item], *dest = &win->dest[item];
+    utf8_source_t source;
+    trace_span_t span;
+    FILE *sfp, *dfp = NULL;
+    html_out_t out = { NULL };
+    int ret;
+
+    (void)worker;
+
+    // Files too large for a batched read are converted the regular way
+    if (src->error == EFBIG)
+    {
+        win->result[item] = convert_file(src->path, src->path);
+        return;
+    }
+    if (src->error != 0)
+    {
+        printf("Error!!! File %s Could Not Be Opened\n", src->path);
+        win->result[item] = 2;
+        return;
+    }
+
+    TRACE_BEGIN(span, "convert", src->path);
+    snprintf(win->dest_files[item], FILENAME_MAX, "%s.html", src->path);
+    dest->path = win->dest_files[item];
+
+    sfp = utf8_source_open_data(&source, (unsigned char *)src->data, src->len);
+    if (sfp != NULL)
+        dfp = open_memstream(&dest->data, &dest->len);
+
+    // Both streams are used by this thread only, skip stdio locking per char
+    if (sfp != NULL && dfp != NULL)
+    {
+        __fsetlocking(sfp, FSETLOCKING_BYCALLER);
+        __fsetlocking(dfp, FSETLOCKING_BYCALLER);
+    }
+
+    out.fp = dfp;
+    ret = (sfp != NULL && dfp != NULL) ? convert_stream(src->path, sfp, &out) : 5;
+    if (dfp != NULL && fclose(dfp) != 0)
+        ret = 5;
+    if (sfp != NULL)
+        utf8_source_close(&source, sfp);
+    free(src->data);
+    src->data = NULL;
+    TRACE_END(span);
+
+    if (ret != 0)
+    {
+        printf("Error!!! Out Of Memory\n");
+        free(dest->data);
+        dest->data = NULL;
+        remove(dest->path); // no stale output of an earlier run
+    }
+    else if (source.invalid > 0)
+    {
+        printf("\nWarning!!! %zu Invalid UTF-8 Sequences In %s Replaced\n", source.invalid, src->path);
+    }
+    win->result[item] = ret;
+}
+
+/* Sets up a window for the given files, its sources are read next. */
+static void window_prepare(convert_window_t *win, char **files, int nfiles, int *status)
+{
+    int idx;
+
+    win->nfiles = nfiles;
+    win->status = status;
+    for (idx = 0; idx < nfiles; idx++)
+    {
+        win->src[idx].path = files[idx];
+        win->dest[idx].path = NULL;
+        win->dest[idx].data = NULL;
+        win->dest[idx].len = 0;
+        win->result[idx] = 0;
+    }
+}
+
+/* Writes the converted outputs of a window and stores the results. */
+static void window_write(convert_window_t *win)
+{
+    trace_span_t span;
+    aio_file_t *out;
+    int idx, item, nwrites = 0;
+
+    for (idx = 0; idx < win->nfiles; idx++)
+    {
+        if (win->dest[idx].data != NULL)
+        {
+            win->writes[nwrites] = win->dest[idx];
+            win->write_item[nwrites++] = idx;
+            win->dest[idx].data = NULL;
+        }
+    }
+
+    TRACE_BEGIN(span, "write", NULL);
+    aio_write_files(win->writes, nwrites);
+    TRACE_END(span);
+
+    for (idx = 0; idx < nwrites; idx++)
+    {
+        out = &win->writes[idx];
+        item = win->write_item[idx];
+        free(out->data);
+
+        if (out->error == 0)
+        {
+            printf("\nOutput File %s Generated\n\n", out->path);
+        }
+        else if (out->stage == AIO_STAGE_OPEN)
+        {
+            printf("Error!!! Could Not Create %s Output File\n", out->path);
+            win->result[item] = 3;
+        }
+        else
+        {
+            printf("Error!!! Could Not Write %s Output File\n", out->path);
+            remove(out->path);
+            win->result[item] = 4;
+        }
+    }
+
+    if (win->status)
+        memcpy(win->status, win->result, win->nfiles * sizeof(int));
+}
+
+/* Writes the previous window and reads the next one (I/O thread). */
+static void *convert_io(void *arg)
+{
+    convert_io_t *io = arg;
+    trace_span_t span;
+
+    if (io->write != NULL)
+        window_write(io->write);
+
+    if (io->read != NULL)
+    {
+        window_prepare(io->read, io->files, io->nfiles, io->status);
+        TRACE_BEGIN(span, "read", NULL);
+        aio_read_files(io->read->src, io->nfiles);
+        TRACE_END(span);
+    }
+
+    return NULL;
+}
+
+/* Converts several files with batched I/O: files are handled in windows,
+ * while the workers convert one window in memory the I/O thread writes the
+ * outputs of the previous window and reads the sources of the next one.
+ * Returns -1 if out of memory (nothing has been done then).
+ */
+static int convert_batch_io(char **files, int nfiles, int *status)
+{
+    convert_window_t *win[2];
+    convert_io_t io;
+    batch_pool_t *pool;
+    pthread_t io_thread;
+    int window, nwindows = (nfiles + CONVERT_WINDOW_FILES - 1) / CONVERT_WINDOW_FILES;
+    int first, count;
+
+    win[0] = malloc(sizeof(convert_window_t));
+    win[1] = malloc(sizeof(convert_window_t));
+    if (win[0] == NULL || win[1] == NULL)
+    {
+        free(win[0]);
+        free(win[1]);
+        return -1;
+    }
+
+    // All windows run on the same workers, which keep their arenas between
+    // windows (watch mode brings its own kept workers)
+    pool = (convert_pool != NULL) ? convert_pool : batch_pool_create(batch_workers());
+
+    // Read the first window, then keep the I/O one window ahead
+    io.write = NULL;
+    io.read = win[0];
+    io.files = files;
+    io.nfiles = (nfiles < CONVERT_WINDOW_FILES) ? nfiles : CONVERT_WINDOW_FILES;
+    io.status = status;
+    convert_io(&io);
+
+    for (window = 0; window < nwindows; window++)
+    {
+        io.write = (window > 0) ? win[(window + 1) % 2] : NULL;
+        io.read = NULL;
+        if (window + 1 < nwindows)
+        {
+            first = (window + 1) * CONVERT_WINDOW_FILES;
+            count = nfiles - first;
+            io.read = win[(window + 1) % 2];
+            io.files = files + first;
+            io.nfiles = (count < CONVERT_WINDOW_FILES) ? count : CONVERT_WINDOW_FILES;
+            io.status = status ? status + first : NULL;
+        }
+
+        // Without an I/O thread the I/O simply follows the conversion
+        if (pthread_create(&io_thread, NULL, convert_io, &io) != 0)
+        {
+            batch_pool_run(pool, win[window % 2]->nfiles, convert_data_work, win[window % 2]);
+            convert_io(&io);
+            continue;
+        }
+        batch_pool_run(pool, win[window % 2]->nfiles, convert_data_work, win[window % 2]);
+        pthread_join(io_thread, NULL);
+    }
+    window_write(win[(nwindows - 1) % 2]);
+
+    if (pool != convert_pool)
+        batch_pool_destroy(pool);
+
+    free(win[0]);
+    free(win[1]);
 
     return 0;
 }
+
+/* Converts several files in parallel, each into '<file>.html', and stores
+ * the result of each in status (if not NULL).
+ */
+static void convert_batch(char **files, int nfiles, int *status)
+{
+    convert_job_t job = { files, status };
+    int idx, prev;
+
+    // Files are spread over the workers, so each compresses on its own
+    gzip_threads = (nfiles > 1) ? 1 : batch_workers();
+
+    // One style sheet per output directory
+    if (html_is_compact())
+    {
+        for (idx = 0; idx < nfiles; idx++)
+        {
+            for (prev = 0; prev < idx && !same_dir(files[prev], files[idx]); prev++)
+                ;
+            if (prev == idx)
+                write_compact_styles(files[idx]);
+        }
+    }
+
+    // Uncompressed output of many files is read and written with batched I/O,
+    // also the bursts of watch mode (converted on its kept workers)
+    if (io_backend != AIO_BACKEND_NONE && !compress && nfiles > 1 &&
+        convert_batch_io(files, nfiles, status) == 0)
+        return;
+
+    batch_pool_run(convert_pool, nfiles, convert_work, &job);
+}
+
+/* Converts several files in parallel (watch mode callback). */
+static void convert_files(char **files, int nfiles)
+{
+    convert_batch(files, nfiles, NULL);
+
+    // Watch mode only ends with a signal, keep the trace file current
+    if (trace_enabled)
+        trace_flush();
+}
+
+/* Shard mode: converts (or in analytics mode lexes) this node's share of the
+ * files listed in the manifest and writes '<manifest>.shard-<i>-of-<N>'.
+ */
+static int run_shard(const char *manifest, int index, int count, int analytics)
+{
+    arena_t *arena = arena_acquire();
+    shard_manifest_t listed;
+    shard_file_t *files;
+    char **paths = NULL;
+    int *status = NULL;
+    stats_t *st = NULL;
+    char result[FILENAME_MAX];
+    int nfiles, nmine = 0, idx, ret = 0;
+
+    if (NULL == (files = shard_read_manifest(manifest, arena, &nfiles, &listed)))
+    {
+        printf("Error!!! Manifest %s Could Not Be Read\n", manifest);
+        arena_release(arena);
+        return 2;
+    }
+
+    // Every node computes the same assignment, keep our own files
+    shard_assign(files, nfiles, count);
+    for (idx = 0; idx < nfiles; idx++)
+    {
+        if (files[idx].shard == index)
+            files[nmine++] = files[idx];
+    }
+
+    paths = malloc((nmine + 1) * sizeof(char *));
+    status = calloc(nmine + 1, sizeof(int));
+    if (paths == NULL || status == NULL)
+    {
+        printf("Error!!! Out Of Memory\n");
+        ret = 5;
+    }
+    else
+    {
+        for (idx = 0; idx < nmine; idx++)
+            paths[idx] = files[idx].path;
+
+        if (analytics)
+        {
+            if (NULL == (st = collect_stats(paths, nmine, status)))
+                ret = 5;
+        }
+        else if (nmine > 0)
+        {
+            convert_batch(paths, nmine, status);
+        }
+    }
+
+    snprintf(result, sizeof(result), "%s.shard-%d-of-%d", manifest, index, count);
+    if (ret == 0 && shard_write_result(result, index, count, &listed, files, nmine, status, st) != 0)
+    {
+        printf("Error!!! Could Not Write %s Shard Result\n", result);
+        ret = 4;
+    }
+    if (ret == 0)
+        printf("\nShard %d/%d : %d Of %d Files, Result %s Generated\n\n", index, count, nmine, nfiles, result);
+
+    for (idx = 0; ret == 0 && idx < nmine; idx++)
+    {
+        if (status[idx] != 0)
+            ret = status[idx];
+    }
+    free(st);
+    free(status);
+    free(paths);
+    free(files);
+    arena_release(arena);
+
+    return ret;
+}
+
+/* Merge mode: combines the shard results into one merged result file. */
+static int run_merge(const char *merged, char **results, int nresults)
+{
+    FILE *fp;
+    int ret;
+
+    if (NULL == (fp = fopen(merged, "w")))
+    {
+        printf("Error!!! Could Not Create %s Output File\n", merged);
+        return 3;
+    }
+
+    ret = shard_merge(results, nresults, fp);
+    if (fclose(fp) != 0 && ret == 0)
+        ret = 4;
+
+    if (ret == 0)
+        printf("\nMerged Result %s Generated\n\n", merged);
+    else
+        remove(merged);
+
+    return ret;
+}
+
+/* Watch mode: converts the given files once, then on every change. */
+static int run_watch(char **paths, int npaths)
+{
+    char **files;
+    struct stat st;
+    int idx, nfiles = 0, ret;
+
+    if (NULL == (files = malloc(npaths * sizeof(char *))))
+    {
+        printf("Error!!! Out Of Memory\n");
+        return 5;
+    }
+
+    // Initial conversion of the named files, directories only convert changes
+    for (idx = 0; idx < npaths; idx++)
+    {
+        if (stat(paths[idx], &st) == 0 && S_ISREG(st.st_mode))
+            files[nfiles++] = paths[idx];
+    }
+    // Files may be truncated while they are converted, never lex them from a mapping
+    utf8_set_mapping(0);
+
+    // Every burst runs on the same workers
+    convert_pool = batch_pool_create(batch_workers());
+    if (nfiles > 0)
+        convert_files(files, nfiles);
+    free(files);
+
+    ret = watch_run(paths, npaths, convert_files);
+    batch_pool_destroy(convert_pool);
+    convert_pool = NULL;
+
+    return ret;
+}
+
+int main (int argc, char *argv[])
+{
+    int argi = 1;      // index of the first non option argument
+    int compact = 0;   // -c : compact output
+    int analytics = 0; // -s : lex-only analytics report
+    int watch = 0;     // -w : watch mode
+    int merge = 0;     // --merge : combine shard results
+    int shard_index = 0, shard_count = 0; // --shard i/N
+    const char *theme_file = NULL;        // -T : theme of regular output
+    const theme_t *theme;
+    const char *dest_prefix;
+    int ret;
+
+    // Parse options
+    while (argi < argc && argv[argi][0] == '-')
+    {
+        if (strcmp(argv[argi], "-z") == 0)
+        {
+            compress = 1;
+        }
+        else if (strcmp(argv[argi], "-c") == 0)
+        {
+            compact = 1;
+        }
+        else if (strcmp(argv[argi], "-s") == 0)
+        {
+            analytics = 1;
+        }
+        else if (strcmp(argv[argi], "-w") == 0)
+        {
+            watch = 1;
+        }
+        else if (strcmp(argv[argi], "--shard") == 0 && argi + 1 < argc)
+        {
+            if (shard_parse(argv[++argi], &shard_index, &shard_count) != 0)
+            {
+                printf("\nError!!! Invalid Shard %s, Expected i/N With 1 <= i <= N\n\n", argv[argi]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--merge") == 0)
+        {
+            merge = 1;
+        }
+        else if (strcmp(argv[argi], "--io") == 0 && argi + 1 < argc)
+        {
+            argi++;
+            if (strcmp(argv[argi], "uring") == 0)
+                io_backend = AIO_BACKEND_URING;
+            else if (strcmp(argv[argi], "threads") == 0)
+                io_backend = AIO_BACKEND_THREADS;
+            else if (strcmp(argv[argi], "off") == 0)
+                io_backend = AIO_BACKEND_NONE;
+            else
+            {
+                printf("\nError!!! Unknown I/O Backend %s, Expected uring, threads Or off\n\n", argv[argi]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "-T") == 0 && argi + 1 < argc)
+        {
+            theme_file = argv[++argi];
+        }
+        else if (strncmp(argv[argi], "-D", 2) == 0 && (argv[argi][2] != '\0' || argi + 1 < argc))
+        {
+            const char *macro = argv[argi][2] ? &argv[argi][2] : argv[++argi];
+
+            if (add_parser_macro(macro) != 0)
+            {
+                printf("\nError!!! Invalid Macro %s, Expected NAME Or NAME=VALUE (At Most %d)\n\n", macro, PEVENT_MAX_MACROS);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc)
+        {
+            if (trace_start(argv[++argi]) != 0)
+            {
+                printf("\nError!!! Could Not Enable Tracing\n\n");
+                return 1;
+            }
+        }
+        else
+        {
+            printf("\nError!!! Unknown Option %s\n\n", argv[argi]);
+            return 1;
+        }
+        argi++;
+    }
+
+    // Check if file name is provided
+    if(argc - argi < 1)
+    {
+        printf("\nError!!! Please Enter File Name And Mode\n");
+        printf("Usage: <executable> [-t trace.json] [-T theme] [-D name[=value]]... [-z] [-c] <file name> [output file prefix]\n");
+        printf("       <executable> -s <file name>...\n");
+        printf("       <executable> [-z] [-c] [--io uring|threads|off] -w <file or directory>...\n");
+        printf("       <executable> [-z] [-c] [-s] [--io uring|threads|off] --shard i/N <manifest>\n");
+        printf("       <executable> --merge <merged file> <shard result>...\n");
+        printf("Example_1 : ./a.out test.c\n\n");
+        printf("Example_2 : ./a.out test.txt\n\n");
+        printf("Example_3 : ./a.out -z test.c\n\n");
+        printf("Example_4 : ./a.out -c test.c\n\n");
+        printf("Example_5 : ./a.out -s test.c test.txt\n\n");
+        printf("Example_6 : ./a.out -w test.c .\n\n");
+        printf("Example_7 : ./a.out --shard 2/4 files.txt\n\n");
+        printf("Example_8 : ./a.out --merge merged.txt files.txt.shard-*\n\n");
+        printf("Example_9 : ./a.out -t trace.json --shard 1/1 files.txt\n\n");
+        printf("Example_10 : ./a.out -T default.theme test.c\n\n");
+        printf("Example_11 : ./a.out --io threads --shard 1/1 files.txt\n\n");
+        printf("Example_12 : ./a.out -D CONFIG_NET -D DEBUG=0 config.h\n\n");
+        return 1;
+    }
+
+    // Merge mode only combines shard results
+    if (merge)
+        return run_merge(argv[argi], &argv[argi + 1], argc - argi - 1);
+
+    // The theme is parsed once and shared by all conversions
+    if (theme_file != NULL)
+    {
+        if (compact)
+        {
+            printf("\nError!!! A Theme Cannot Be Used With Compact Output\n\n");
+            return 1;
+        }
+        if ((ret = theme_load(theme_file, &theme)) != 0)
+        {
+            if (ret < 0)
+            {
+                printf("Error!!! Theme %s Could Not Be Read\n", theme_file);
+                return 2;
+            }
+            printf("Error!!! Invalid Theme %s, Line %d\n", theme_file, ret);
+            return 1;
+        }
+        html_set_theme(theme);
+    }
+
+    // Batch conversions read and write their files with batched I/O (io_uring if available)
+    if ((shard_count > 0 || watch) && !analytics && !compress && io_backend != AIO_BACKEND_NONE)
+        io_backend = aio_start(io_backend);
+
+    // Shard mode converts (or lexes) every file of the shard next to its source
+    html_set_compact(compact);
+    if (shard_count > 0)
+        return run_shard(argv[argi], shard_index, shard_count, analytics);
+
+    // Analytics mode only lexes, no output files are written
+    if (analytics)
+        return run_stats(&argv[argi], argc - argi);
+
+    // Watch mode converts every file next to its source
+    if (watch)
+        return run_watch(&argv[argi], argc - argi);
+
+    // Check for output file name, default to source file name
+    dest_prefix = (argc - argi > 1) ? argv[argi + 1] : argv[argi];
+
+    // Compressed output of a single file uses one block per online CPU
+    gzip_threads = batch_workers();
+
+    // Compact output links a generated stylesheet
+    if (compact && write_compact_styles(dest_prefix) != 0)
+        return 3;
+
+    return convert_file(argv[argi], dest_prefix);
+}
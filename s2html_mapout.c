@@ -0,0 +1,149 @@
+/*
+ * Memory Mapped Output Functions
+ *
+ * This file implements an output (html_out_t) whose memory area is a shared
+ * mapping of the output file, so the renderer copies its markup straight
+ * into the page cache: no stdio buffer and no write() per block.
+ *
+ * The file is allocated (not just extended, so a full disk is reported as a
+ * failed conversion and not as SIGBUS) from an estimate of the output size
+ * and grown in large steps. On close the mapping is released and the file is
+ * truncated to the bytes actually rendered.
+ *
+ * Main features:
+ * - mapout_open: Creates the file and maps its first estimate.
+ * - mo_grow: Grows the file and its mapping when the renderer runs out of room.
+ * - mapout_close: Releases the mapping and cuts the file to its length.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "s2html_event.h"
+#include "s2html_theme.h"
+#include "s2html_conv.h"
+#include "s2html_mapout.h"
+
+/* bytes read and written by the conversions finished so far, shared by all threads */
+static size_t mapout_in_bytes = 0;
+static size_t mapout_out_bytes = 0;
+
+/********** Utility functions **********/
+
+/* rounds up to whole pages */
+static size_t mo_page_align(size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return (size + page - 1) / page * page;
+}
+
+/* estimated output size of a source of 'src_size' bytes */
+static size_t mo_estimate(size_t src_size)
+{
+    size_t in = __atomic_load_n(&mapout_in_bytes, __ATOMIC_RELAXED);
+    size_t out = __atomic_load_n(&mapout_out_bytes, __ATOMIC_RELAXED);
+    double ratio = in > 0 ? (double)out / in : MAPOUT_FIRST_RATIO;
+
+    /* a little extra so an average file does not need to grow at its end */
+    return mo_page_align((size_t)(src_size * ratio) + src_size / 16 + 1);
+}
+
+/* Makes room for 'need' more bytes after the rendered ones: allocates and
+ * maps a larger file, the mapping may move. Returns 0 or -1 with errno set.
+ */
+static int mo_grow(html_out_t *out, size_t need)
+{
+    mapout_t *mo = (mapout_t *)out;
+    size_t len = mo->map != NULL ? (size_t)(out->pos - mo->map) : 0;
+    size_t size = mo->size + (mo->size / 2 > MAPOUT_GROW_STEP ? mo->size / 2 : MAPOUT_GROW_STEP);
+    char *map;
+    int err;
+
+    if (size < len + need)
+        size = len + need;
+    size = mo_page_align(size);
+
+    if ((err = posix_fallocate(mo->fd, 0, size)) != 0)
+    {
+        errno = err;
+        return -1;
+    }
+
+    if (mo->map == NULL)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mo->fd, 0);
+    else
+        map = mremap(mo->map, mo->size, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED)
+        return -1;
+
+    mo->map = map;
+    mo->size = size;
+    out->pos = map + len;
+    out->end = map + size;
+
+    return 0;
+}
+
+/************ Mapped output functions **********/
+
+/* Creates 'path' and maps it for the output of a source of 'src_size' bytes.
+ * Returns NULL if the file could not be created or mapped.
+ */
+mapout_t *mapout_open(const char *path, size_t src_size)
+{
+    mapout_t *mo;
+
+    if (NULL == (mo = calloc(1, sizeof(*mo))))
+        return NULL;
+    mo->src_size = src_size;
+    mo->out.grow = mo_grow;
+
+    if ((mo->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+    {
+        free(mo);
+        return NULL;
+    }
+
+    if (mo_grow(&mo->out, mo_estimate(src_size)) != 0)
+    {
+        close(mo->fd);
+        unlink(path);
+        free(mo);
+        return NULL;
+    }
+
+    return mo;
+}
+
+/* Releases the mapping and cuts the file to the rendered length.
+ * Returns 0, or -1 if the output is incomplete or could not be finished.
+ */
+int mapout_close(mapout_t *mo)
+{
+    size_t len = mo->out.pos - mo->map;
+    int ret = mo->out.error ? -1 : 0;
+
+    if (munmap(mo->map, mo->size) != 0)
+        ret = -1;
+    if (ftruncate(mo->fd, len) != 0)
+        ret = -1;
+    if (close(mo->fd) != 0)
+        ret = -1;
+
+    if (ret == 0)
+    {
+        __atomic_add_fetch(&mapout_in_bytes, mo->src_size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&mapout_out_bytes, len, __ATOMIC_RELAXED);
+    }
+    free(mo);
+
+    return ret;
+}
+
+/**** End of file ****/
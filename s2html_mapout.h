@@ -0,0 +1,47 @@
+/*
+ * Header for memory mapped HTML output.
+ *
+ * Large conversions render their output straight into a shared mapping of the
+ * destination file, without stdio buffers or write() calls in between.
+ * The file is allocated ahead of time from the source size times the
+ * expansion ratio (output / input bytes) seen so far, grown in large steps
+ * when the estimate is short and truncated to the written length on close.
+ *
+ * Constants:
+ * - MAPOUT_MIN_INPUT: Smallest source converted through a mapping.
+ * - MAPOUT_GROW_STEP: Smallest step the mapping is grown by.
+ * - MAPOUT_FIRST_RATIO: Expansion ratio assumed before the first conversion.
+ *
+ * Structures:
+ * - mapout_t: Mapped output file, its html_out_t is passed to the renderer.
+ *
+ * Functions:
+ * - mapout_open: Creates and maps an output file.
+ * - mapout_close: Unmaps the output file and cuts it to the rendered length.
+ */
+
+#ifndef S2HTML_MAPOUT_H
+#define S2HTML_MAPOUT_H
+
+#include <stddef.h>
+
+#define MAPOUT_MIN_INPUT	(1024 * 1024)
+#define MAPOUT_GROW_STEP	(4 * 1024 * 1024)
+#define MAPOUT_FIRST_RATIO	4
+
+typedef struct
+{
+    html_out_t out;        // rendered into, must stay the first member
+    int fd;                // output file
+    char *map;             // shared mapping of the whole allocated file
+    size_t size;           // allocated and mapped bytes
+    size_t src_size;       // size of the source, for the expansion ratio
+} mapout_t;
+
+/********** function prototypes **********/
+
+mapout_t *mapout_open(const char *path, size_t src_size); // Creates path for the output of a source of src_size bytes.
+int mapout_close(mapout_t *mo);                           // Finishes the file, returns 0 or -1 if it is incomplete.
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,376 @@
+/*
+ * Corpus Sharding Functions
+ *
+ * This file splits the files listed in a manifest into N shards. A manifest
+ * line is "<size> <path>" (e.g. from find -printf '%s %p\n'), and the
+ * assignment depends only on the manifest: files are ordered by size
+ * (largest first, ties by path) and each goes to the shard with the smallest
+ * total so far (ties to the lowest shard). Every node therefore computes the
+ * same, size balanced split whatever its disk holds, and a failed shard can
+ * be rerun on its own.
+ *
+ * Shard results are text files:
+ *   shard <i>/<N>
+ *   manifest <entries> <fingerprint>
+ *   file <ok|failed> <size> <path>
+ *   <analytics report lines, if any>
+ *
+ * The fingerprint is the sum of a hash of every "<size> <path>" entry, so the
+ * merge can check that the file lines of all shards are exactly the entries
+ * of the manifest.
+ *
+ * Main features:
+ * - shard_read_manifest / shard_assign: Deterministic, size balanced split.
+ * - shard_write_result / shard_merge: Per shard results and their merge.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "s2html_event.h"
+#include "s2html_stats.h"
+#include "s2html_shard.h"
+
+#define SHARD_MAX_COUNT		4096
+
+/********** Utility functions **********/
+
+/* orders files by descending size, then by path */
+static int shard_file_cmp(const void *a, const void *b)
+{
+	const shard_file_t *fa = a, *fb = b;
+
+	if(fa->size != fb->size)
+		return fa->size < fb->size ? 1 : -1;
+
+	return strcmp(fa->path, fb->path);
+}
+
+/* orders result lines by the path at their end */
+static int shard_line_cmp(const void *a, const void *b)
+{
+	const char *la = *(const char * const *)a, *lb = *(const char * const *)b;
+	int skip_a = 0, skip_b = 0;
+
+	/* skip "file <status> <size> " */
+	sscanf(la, "%*s %*s %*s %n", &skip_a);
+	sscanf(lb, "%*s %*s %*s %n", &skip_b);
+
+	return strcmp(la + skip_a, lb + skip_b);
+}
+
+/* hash of one manifest entry (FNV-1a of "<size> <path>") */
+static unsigned long long shard_entry_hash(long size, const char *path)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	char size_str[24];
+	const char *ch;
+
+	snprintf(size_str, sizeof(size_str), "%ld ", size);
+	for(ch = size_str; *ch; ch++)
+		hash = (hash ^ (unsigned char)*ch) * 1099511628211ULL;
+	for(ch = path; *ch; ch++)
+		hash = (hash ^ (unsigned char)*ch) * 1099511628211ULL;
+
+	return hash;
+}
+
+/* removes a trailing newline (and carriage return) */
+static void shard_chomp(char *line)
+{
+	size_t len = strlen(line);
+
+	while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+		line[--len] = '\0';
+}
+
+/************ Shard functions **********/
+
+/* Parses "i/N" with 1 <= i <= N. Returns 0 on success, -1 if invalid. */
+int shard_parse(const char *spec, int *index, int *count)
+{
+	char end;
+
+	if(sscanf(spec, "%d/%d%c", index, count, &end) != 2)
+		return -1;
+	if(*count < 1 || *count > SHARD_MAX_COUNT || *index < 1 || *index > *count)
+		return -1;
+
+	return 0;
+}
+
+/* Reads the manifest ("<size> <path>" per line, empty lines and lines
+ * starting with '#' are skipped) and its fingerprint. Paths are stored in
+ * the arena, the returned array must be freed by the caller. Returns NULL on
+ * error, e.g. a line without a size.
+ */
+shard_file_t *shard_read_manifest(const char *path, arena_t *arena, int *nfiles, shard_manifest_t *manifest)
+{
+	shard_file_t *files = NULL, *grown;
+	int capacity = 0, failed = 0, line_no = 0, skip;
+	char *line = NULL;
+	size_t line_size = 0;
+	long size;
+	FILE *fp;
+
+	*nfiles = 0;
+	manifest->entries = 0;
+	manifest->hash = 0;
+	if(NULL == (fp = fopen(path, "r")))
+		return NULL;
+
+	while(getline(&line, &line_size, fp) != -1)
+	{
+		line_no++;
+		shard_chomp(line);
+		if(line[0] == '\0' || line[0] == '#')
+			continue;
+
+		/* the path is the rest of the line after one blank, it may hold blanks itself */
+		skip = 0;
+		if(sscanf(line, "%ld%n", &size, &skip) != 1 || size < 0 ||
+		   (line[skip] != ' ' && line[skip] != '\t') || line[skip + 1] == '\0')
+		{
+			printf("Error!!! Manifest %s Line %d Is Not '<size> <path>'\n", path, line_no);
+			failed = 1;
+			break;
+		}
+
+		if(*nfiles == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 256;
+			if(NULL == (grown = realloc(files, capacity * sizeof(shard_file_t))))
+				break;
+			files = grown;
+		}
+
+		if(NULL == (files[*nfiles].path = arena_strndup(arena, line + skip + 1, strlen(line + skip + 1))))
+			break;
+		files[*nfiles].size = size;
+		files[*nfiles].shard = 0;
+		manifest->hash += shard_entry_hash(size, files[*nfiles].path);
+		(*nfiles)++;
+	}
+	manifest->entries = *nfiles;
+
+	free(line);
+	failed = failed || ferror(fp) || !feof(fp);
+	fclose(fp);
+	if(failed)
+	{
+		free(files);
+		return NULL;
+	}
+
+	/* an empty manifest is valid */
+	if(files == NULL)
+		files = calloc(1, sizeof(shard_file_t));
+
+	return files;
+}
+
+/* Assigns every file to one of 'count' shards (sets shard_file_t.shard).
+ * The array is reordered, largest files first.
+ */
+void shard_assign(shard_file_t *files, int nfiles, int count)
+{
+	long long load[SHARD_MAX_COUNT] = { 0 };
+	int idx, shard, least;
+
+	qsort(files, nfiles, sizeof(shard_file_t), shard_file_cmp);
+
+	for(idx = 0; idx < nfiles; idx++)
+	{
+		least = 0;
+		for(shard = 1; shard < count; shard++)
+		{
+			if(load[shard] < load[least])
+				least = shard;
+		}
+
+		/* +1 so that empty files are spread as well */
+		load[least] += files[idx].size + 1;
+		files[idx].shard = least + 1;
+	}
+}
+
+/* Writes the result of shard index/count: the manifest fingerprint, the
+ * files of this shard with their status (non zero marks a failed file) and
+ * the analytics report 'st' if given. Returns 0 on success, -1 on error.
+ */
+int shard_write_result(const char *path, int index, int count, const shard_manifest_t *manifest,
+					   shard_file_t *files, int nfiles, const int *status, const stats_t *st)
+{
+	FILE *fp;
+	int idx;
+
+	if(NULL == (fp = fopen(path, "w")))
+		return -1;
+
+	fprintf(fp, "shard %d/%d\n", index, count);
+	fprintf(fp, "manifest %d %016llx\n", manifest->entries, manifest->hash);
+	for(idx = 0; idx < nfiles; idx++)
+	{
+		fprintf(fp, "file %s %ld %s\n", status[idx] ? "failed" : "ok",
+				files[idx].size, files[idx].path);
+	}
+	if(st != NULL)
+		stats_print(fp, st);
+
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* Combines the results of all shards of one run into 'out': every file line
+ * (ordered by path) followed by the merged analytics report, if the shards
+ * have one. Every shard 1..N must be given exactly once, and together their
+ * file lines must be exactly the entries of the manifest (none missing, none
+ * twice). Returns 0 on success or the program exit code of the failure.
+ */
+int shard_merge(char **results, int nresults, FILE *out)
+{
+	arena_t *arena = arena_acquire();
+	char **lines = NULL, **grown;
+	int nlines = 0, capacity = 0;
+	unsigned char seen[SHARD_MAX_COUNT + 1] = { 0 };
+	int count = 0, index, shard_count, has_stats = 0, ret = 0, idx;
+	int entries = -1, manifest_entries, skip;
+	unsigned long long hash = 0, manifest_hash = 0, line_hash;
+	long size;
+	char *line = NULL;
+	size_t line_size = 0;
+	stats_t *st = calloc(1, sizeof(stats_t));
+	FILE *fp;
+
+	if(arena == NULL || st == NULL)
+	{
+		printf("Error!!! Out Of Memory\n");
+		arena_release(arena);
+		free(st);
+		return 5;
+	}
+
+	for(idx = 0; idx < nresults && ret == 0; idx++)
+	{
+		if(NULL == (fp = fopen(results[idx], "r")))
+		{
+			printf("Error!!! File %s Could Not Be Opened\n", results[idx]);
+			ret = 2;
+			break;
+		}
+
+		while(ret == 0 && getline(&line, &line_size, fp) != -1)
+		{
+			shard_chomp(line);
+			if(sscanf(line, "shard %d/%d", &index, &shard_count) == 2)
+			{
+				if((count && shard_count != count) || shard_count < 1 ||
+				   shard_count > SHARD_MAX_COUNT || index < 1 || index > shard_count || seen[index])
+				{
+					printf("Error!!! Shard Result %s Does Not Belong To This Run\n", results[idx]);
+					ret = 7;
+				}
+				else
+				{
+					count = shard_count;
+					seen[index] = 1;
+				}
+			}
+			else if(sscanf(line, "manifest %d %llx", &manifest_entries, &line_hash) == 2)
+			{
+				if(entries >= 0 && (manifest_entries != entries || line_hash != manifest_hash))
+				{
+					printf("Error!!! Shard Result %s Is Of Another Manifest\n", results[idx]);
+					ret = 7;
+				}
+				entries = manifest_entries;
+				manifest_hash = line_hash;
+			}
+			else if(strncmp(line, "file ", 5) == 0)
+			{
+				skip = 0;
+				if(sscanf(line, "file %*s %ld%n", &size, &skip) != 1 || line[skip] != ' ')
+				{
+					printf("Error!!! Shard Result %s Is Damaged\n", results[idx]);
+					ret = 7;
+					break;
+				}
+				hash += shard_entry_hash(size, line + skip + 1);
+
+				if(nlines == capacity)
+				{
+					capacity = capacity ? capacity * 2 : 1024;
+					if(NULL == (grown = realloc(lines, capacity * sizeof(char *))))
+					{
+						ret = 5;
+						break;
+					}
+					lines = grown;
+				}
+				if(NULL == (lines[nlines++] = arena_strndup(arena, line, strlen(line))))
+					ret = 5;
+			}
+			else if(stats_parse_line(st, line))
+			{
+				has_stats = 1;
+			}
+		}
+		fclose(fp);
+	}
+
+	if(ret == 5)
+		printf("Error!!! Out Of Memory\n");
+	else if(ret == 0 && count == 0)
+	{
+		printf("Error!!! No Shard Results Given\n");
+		ret = 7;
+	}
+
+	for(index = 1; ret == 0 && index <= count; index++)
+	{
+		if(!seen[index])
+		{
+			printf("Error!!! Shard %d/%d Is Missing\n", index, count);
+			ret = 7;
+		}
+	}
+
+	/* every manifest entry in exactly one shard */
+	if(ret == 0 && entries < 0)
+	{
+		printf("Error!!! Shard Results Have No Manifest\n");
+		ret = 7;
+	}
+	if(ret == 0)
+		qsort(lines, nlines, sizeof(char *), shard_line_cmp);
+	for(idx = 1; ret == 0 && idx < nlines; idx++)
+	{
+		if(shard_line_cmp(&lines[idx - 1], &lines[idx]) == 0)
+		{
+			printf("Error!!! File Line '%s' Is In More Than One Shard\n", lines[idx]);
+			ret = 7;
+		}
+	}
+	if(ret == 0 && (nlines != entries || hash != manifest_hash))
+	{
+		printf("Error!!! Shard Results Do Not Cover The Manifest (%d Of %d Files)\n", nlines, entries);
+		ret = 7;
+	}
+
+	if(ret == 0)
+	{
+		fprintf(out, "shards %d\n", count);
+		for(idx = 0; idx < nlines; idx++)
+			fprintf(out, "%s\n", lines[idx]);
+		if(has_stats)
+			stats_print(out, st);
+	}
+
+	free(line);
+	free(lines);
+	free(st);
+	arena_release(arena);
+
+	return ret;
+}
+
+/**** End of file ****/
@@ -0,0 +1,50 @@
+/*
+ * Header for deterministic sharding of a corpus across machines.
+ *
+ * Every node reads the same manifest ("<size> <path>" per source file) and
+ * computes the same size balanced assignment of files to shards, so each
+ * node converts its own share without any coordination. The sizes are taken
+ * from the manifest, never from the node's disk. A node writes a shard
+ * result (the files it handled and, in analytics mode, its report); the
+ * merge step combines the results of all shards into one and checks that
+ * every manifest entry was handled by exactly one shard.
+ *
+ * Structures:
+ * - shard_file_t: A manifest entry with its size and assigned shard.
+ * - shard_manifest_t: Number of entries and fingerprint of a manifest.
+ *
+ * Functions:
+ * - shard_parse: Parses an "i/N" shard specification.
+ * - shard_read_manifest: Reads the manifest entries.
+ * - shard_assign: Assigns every file to a shard (stable, size balanced).
+ * - shard_write_result: Writes the result of one shard.
+ * - shard_merge: Combines the results of all shards.
+ */
+
+#ifndef S2HTML_SHARD_H
+#define S2HTML_SHARD_H
+
+typedef struct
+{
+	char *path;          // source file, as listed in the manifest
+	long size;           // size in bytes, as listed in the manifest
+	int shard;           // assigned shard, 1 based
+} shard_file_t;
+
+typedef struct
+{
+	int entries;                 // files listed
+	unsigned long long hash;     // order independent fingerprint of all entries
+} shard_manifest_t;
+
+/********** function prototypes **********/
+
+int shard_parse(const char *spec, int *index, int *count);
+shard_file_t *shard_read_manifest(const char *path, arena_t *arena, int *nfiles, shard_manifest_t *manifest);
+void shard_assign(shard_file_t *files, int nfiles, int count);
+int shard_write_result(const char *path, int index, int count, const shard_manifest_t *manifest,
+					   shard_file_t *files, int nfiles, const int *status, const stats_t *st);
+int shard_merge(char **results, int nresults, FILE *out);
+
+#endif
+/**** End of file ****/
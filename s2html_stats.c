@@ -0,0 +1,450 @@
+/*
+ * Source Analytics Functions
+ *
+ * This file collects code metrics by running only the lexer over source
+ * files: lines of code, comment lines, events per type and keyword
+ * frequency. Nothing is rendered, so a scan costs little more than reading
+ * the files. Events are counted from the lexer; lines and keywords are
+ * counted from the source bytes, since the lexer does not hand out every
+ * character (identifiers, numbers and literals are dropped).
+ *
+ * The report is written as "<key> <value>..." lines so it is easy to read
+ * and to process with other tools.
+ *
+ * Main features:
+ * - stats_scan_file: Lexes a file and counts its events, lines and keywords.
+ * - stats_merge / stats_print: Combines per worker counts into one report.
+ * - stats_parse_line: Reads a report back, so reports of several runs
+ *   (e.g. shards) can be merged.
+*/
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include "s2html_event.h"
+#include "s2html_stats.h"
+#include "s2html_utf8.h"
+
+#define STATS_READ_BUFF_SIZE	(64 * 1024)
+
+/* report names of the event types */
+static const char *event_names[STATS_EVENT_TYPES] = {
+	[PEVENT_NULL]                   = "null",
+	[PEVENT_PREPROCESSOR_DIRECTIVE] = "preprocessor_directive",
+	[PEVENT_RESERVE_KEYWORD]        = "reserve_keyword",
+	[PEVENT_NUMERIC_CONSTANT]       = "numeric_constant",
+	[PEVENT_STRING]                 = "string",
+	[PEVENT_HEADER_FILE]            = "header_file",
+	[PEVENT_REGULAR_EXP]            = "regular_exp",
+	[PEVENT_SINGLE_LINE_COMMENT]    = "single_line_comment",
+	[PEVENT_MULTI_LINE_COMMENT]     = "multi_line_comment",
+	[PEVENT_ASCII_CHAR]             = "ascii_char",
+	[PEVENT_INACTIVE_REGION]        = "inactive_region",
+	[PEVENT_EOF]                    = "eof",
+};
+
+/* states of the line and keyword scan of the source bytes */
+typedef enum
+{
+	STATS_SCAN_CODE,
+	STATS_SCAN_LINE_COMMENT,
+	STATS_SCAN_BLOCK_COMMENT,
+	STATS_SCAN_LITERAL
+} stats_scan_e;
+
+/* line classification state while scanning one file */
+typedef struct
+{
+	int open;       // line has any character
+	int code;       // line has non blank code
+	int comment;    // line has non blank comment text
+} stats_line_t;
+
+/********** Utility functions **********/
+
+/* counts a finished line */
+static void stats_end_line(stats_t *st, stats_line_t *line)
+{
+	st->lines++;
+	if(line->code)
+		st->code_lines++;
+	else if(line->comment)
+		st->comment_lines++;
+	else
+		st->blank_lines++;
+
+	memset(line, 0, sizeof(*line));
+}
+
+/* adds 'count' occurrences of a keyword to the frequency table */
+static void stats_add_keyword(stats_t *st, const char *name, unsigned long count)
+{
+	unsigned int hash = 2166136261u; // FNV-1a
+	const char *ch;
+	int probe, slot;
+
+	if(strlen(name) >= STATS_KEYWORD_SIZE)
+		return;
+
+	for(ch = name; *ch; ch++)
+		hash = (hash ^ (unsigned char)*ch) * 16777619u;
+
+	for(probe = 0; probe < STATS_MAX_KEYWORDS; probe++)
+	{
+		slot = (hash + probe) % STATS_MAX_KEYWORDS;
+		if(st->keywords[slot].name[0] == '\0')
+			strcpy(st->keywords[slot].name, name);
+		if(strcmp(st->keywords[slot].name, name) == 0)
+		{
+			st->keywords[slot].count += count;
+			return;
+		}
+	}
+	// table full, keyword is not counted
+}
+
+/* counts a word of code if it is a keyword of the language */
+static void stats_add_word(stats_t *st, const lang_t *lang, const char *word)
+{
+	const char *const *kw;
+
+	for(kw = lang->keywords_data; **kw; kw++)
+	{
+		if(strcmp(*kw, word) == 0)
+		{
+			stats_add_keyword(st, word, 1);
+			return;
+		}
+	}
+	for(kw = lang->keywords_non_data; **kw; kw++)
+	{
+		if(strcmp(*kw, word) == 0)
+		{
+			stats_add_keyword(st, word, 1);
+			return;
+		}
+	}
+}
+
+/* tells whether 'delim' (may be empty) starts at data[idx] */
+static int stats_delim_at(const unsigned char *data, size_t len, size_t idx, const char *delim)
+{
+	size_t dlen = strlen(delim);
+
+	return dlen > 0 && idx + dlen <= len && memcmp(data + idx, delim, dlen) == 0;
+}
+
+/* Classifies the lines of a source from its bytes and counts its keywords and preprocessor directives.
+ * Comments and literals are found with the comment delimiters and quote
+ * classes of the language. A line is code if it has a non blank char outside
+ * comments, a comment line if it only has comment text, blank otherwise.
+ */
+static void stats_scan_source(stats_t *st, const lang_t *lang, const unsigned char *data, size_t len)
+{
+	stats_line_t line = { 0, 0, 0 };
+	stats_scan_e scan = STATS_SCAN_CODE;
+	char word[STATS_KEYWORD_SIZE];
+	int word_len = -1;              // length of the word being read, -1 outside words
+	int quote = 0, blank, cls;
+	unsigned char ch, prev = '\n';
+	size_t idx;
+
+	for(idx = 0; idx < len; prev = ch, idx++)
+	{
+		ch = data[idx];
+
+		/* a word of code ends at the first char which cannot continue it */
+		if(word_len >= 0 && !isalnum(ch) && ch != '_')
+		{
+			if(word_len > 0 && word_len < STATS_KEYWORD_SIZE)
+			{
+				word[word_len] = '\0';
+				stats_add_word(st, lang, word);
+			}
+			word_len = -1;
+		}
+
+		if(ch == '\n')
+		{
+			stats_end_line(st, &line);
+			if(scan == STATS_SCAN_LINE_COMMENT)
+				scan = STATS_SCAN_CODE;
+			continue;
+		}
+		line.open = 1;
+		blank = isspace(ch);
+
+		switch(scan)
+		{
+			case STATS_SCAN_CODE :
+				if(stats_delim_at(data, len, idx, lang->line_comment) && lang_comment_starts(lang, prev))
+				{
+					scan = STATS_SCAN_LINE_COMMENT;
+					line.comment = 1;
+					break;
+				}
+				if(stats_delim_at(data, len, idx, lang->block_open))
+				{
+					scan = STATS_SCAN_BLOCK_COMMENT;
+					line.comment = 1;
+					idx += strlen(lang->block_open) - 1;
+					ch = data[idx];
+					break;
+				}
+				/* a directive starts with the first char of code on its line */
+				cls = lang->classes[ch];
+				if(cls == LANG_CC_PREPROCESSOR && !line.code)
+					st->directive_lines++;
+				if(!blank)
+					line.code = 1;
+
+				if(cls == LANG_CC_STRING || cls == LANG_CC_CHAR || cls == LANG_CC_RAW_STRING)
+				{
+					scan = STATS_SCAN_LITERAL;
+					quote = ch;
+				}
+				else if(word_len < 0 && (isalpha(ch) || ch == '_') && !isalnum(prev) && prev != '_')
+				{
+					word[0] = ch;
+					word_len = 1;
+				}
+				else if(word_len > 0)
+				{
+					if(word_len < STATS_KEYWORD_SIZE)
+						word[word_len] = ch;
+					word_len++;
+				}
+				break;
+			case STATS_SCAN_LINE_COMMENT :
+				if(!blank)
+					line.comment = 1;
+				break;
+			case STATS_SCAN_BLOCK_COMMENT :
+				if(!blank)
+					line.comment = 1;
+				if(stats_delim_at(data, len, idx, lang->block_close))
+				{
+					scan = STATS_SCAN_CODE;
+					idx += strlen(lang->block_close) - 1;
+					ch = data[idx];
+				}
+				break;
+			case STATS_SCAN_LITERAL :
+				if(!blank)
+					line.code = 1;
+				if(ch == '\\' && lang->classes[quote] != LANG_CC_RAW_STRING && idx + 1 < len && data[idx + 1] != '\n')
+					ch = data[++idx]; // escaped char, e.g. the quote
+				else if(ch == quote)
+					scan = STATS_SCAN_CODE;
+				break;
+		}
+	}
+
+	if(word_len > 0 && word_len < STATS_KEYWORD_SIZE)
+	{
+		word[word_len] = '\0';
+		stats_add_word(st, lang, word);
+	}
+
+	/* last line without newline */
+	if(line.open)
+		stats_end_line(st, &line);
+}
+
+/* orders keywords by descending count, then by name */
+static int stats_keyword_cmp(const void *a, const void *b)
+{
+	const stats_keyword_t *ka = a, *kb = b;
+
+	if(ka->count != kb->count)
+		return ka->count < kb->count ? 1 : -1;
+
+	return strcmp(ka->name, kb->name);
+}
+
+/************ Analytics functions **********/
+
+/* Clears all counts. */
+void stats_init(stats_t *st)
+{
+	memset(st, 0, sizeof(*st));
+}
+
+/* Lexes the file at 'path' and adds its counts to 'st'. Returns 0 on
+ * success, -1 if the file could not be opened (counted as failed).
+ */
+int stats_scan_file(stats_t *st, const char *path)
+{
+	static __thread char read_buff[STATS_READ_BUFF_SIZE];
+	const lang_t *lang = lang_for_path(path);
+	utf8_source_t src;
+	pevent_t *event;
+	FILE *fp;
+
+	/* lexed like a conversion: validated, invalid UTF-8 repaired */
+	if(NULL == (fp = utf8_source_open(&src, path)))
+	{
+		st->failed++;
+		return -1;
+	}
+
+	/* the stream is used by this thread only, skip stdio locking per char */
+	__fsetlocking(fp, FSETLOCKING_BYCALLER);
+	setvbuf(fp, read_buff, _IOFBF, sizeof(read_buff));
+
+	st->bytes += src.map != NULL ? src.map_len : src.read_len;
+	st->invalid_utf8 += src.invalid;
+	stats_scan_source(st, lang, src.data, src.len);
+
+	set_parser_language(lang);
+
+	do
+	{
+		event = get_parser_event(fp);
+		st->events[event->type]++;
+		st->event_bytes[event->type] += event->length;
+	} while(event->type != PEVENT_EOF);
+
+	st->files++;
+	utf8_source_close(&src, fp);
+
+	return 0;
+}
+
+/* Adds all counts of 'src' to 'dst'. */
+void stats_merge(stats_t *dst, const stats_t *src)
+{
+	int idx;
+
+	dst->files += src->files;
+	dst->failed += src->failed;
+	dst->bytes += src->bytes;
+	dst->invalid_utf8 += src->invalid_utf8;
+	dst->lines += src->lines;
+	dst->code_lines += src->code_lines;
+	dst->comment_lines += src->comment_lines;
+	dst->blank_lines += src->blank_lines;
+	dst->directive_lines += src->directive_lines;
+
+	for(idx = 0; idx < STATS_EVENT_TYPES; idx++)
+	{
+		dst->events[idx] += src->events[idx];
+		dst->event_bytes[idx] += src->event_bytes[idx];
+	}
+
+	for(idx = 0; idx < STATS_MAX_KEYWORDS; idx++)
+	{
+		if(src->keywords[idx].name[0])
+			stats_add_keyword(dst, src->keywords[idx].name, src->keywords[idx].count);
+	}
+}
+
+/* Writes the report: totals, derived ratios, events per type and keyword
+ * frequency (most frequent first).
+ */
+void stats_print(FILE *fp, const stats_t *st)
+{
+	stats_keyword_t sorted[STATS_MAX_KEYWORDS];
+	unsigned long comment_bytes = st->event_bytes[PEVENT_SINGLE_LINE_COMMENT] +
+								  st->event_bytes[PEVENT_MULTI_LINE_COMMENT];
+	int idx, count = 0;
+
+	fprintf(fp, "files %lu\n", st->files);
+	fprintf(fp, "files_failed %lu\n", st->failed);
+	fprintf(fp, "bytes %lu\n", st->bytes);
+	fprintf(fp, "invalid_utf8 %lu\n", st->invalid_utf8);
+	fprintf(fp, "lines %lu\n", st->lines);
+	fprintf(fp, "code_lines %lu\n", st->code_lines);
+	fprintf(fp, "comment_lines %lu\n", st->comment_lines);
+	fprintf(fp, "blank_lines %lu\n", st->blank_lines);
+	fprintf(fp, "directive_lines %lu\n", st->directive_lines);
+
+	/* derived metrics */
+	fprintf(fp, "comment_line_ratio %.4f\n",
+			st->lines ? (double)st->comment_lines / st->lines : 0.0);
+	fprintf(fp, "comment_byte_ratio %.4f\n",
+			st->bytes ? (double)comment_bytes / st->bytes : 0.0);
+	fprintf(fp, "preprocessor_per_kloc %.2f\n",
+			st->code_lines ? 1000.0 * st->directive_lines / st->code_lines : 0.0);
+
+	for(idx = 0; idx < STATS_EVENT_TYPES; idx++)
+	{
+		if(idx == PEVENT_NULL || idx == PEVENT_EOF)
+			continue;
+		fprintf(fp, "event %s %lu %lu\n", event_names[idx], st->events[idx], st->event_bytes[idx]);
+	}
+
+	for(idx = 0; idx < STATS_MAX_KEYWORDS; idx++)
+	{
+		if(st->keywords[idx].name[0])
+			sorted[count++] = st->keywords[idx];
+	}
+	qsort(sorted, count, sizeof(sorted[0]), stats_keyword_cmp);
+	for(idx = 0; idx < count; idx++)
+		fprintf(fp, "keyword %s %lu\n", sorted[idx].name, sorted[idx].count);
+}
+
+/* Adds the counts of one report line to 'st'. Derived metrics are skipped,
+ * they are recomputed when printing. Returns 1 if the line belongs to a
+ * report, 0 otherwise.
+ */
+int stats_parse_line(stats_t *st, const char *line)
+{
+	static const struct
+	{
+		const char *key;
+		size_t offset;
+	} totals[] = {
+		{ "files",         offsetof(stats_t, files) },
+		{ "files_failed",  offsetof(stats_t, failed) },
+		{ "bytes",         offsetof(stats_t, bytes) },
+		{ "invalid_utf8",  offsetof(stats_t, invalid_utf8) },
+		{ "lines",         offsetof(stats_t, lines) },
+		{ "code_lines",    offsetof(stats_t, code_lines) },
+		{ "comment_lines", offsetof(stats_t, comment_lines) },
+		{ "blank_lines",   offsetof(stats_t, blank_lines) },
+		{ "directive_lines", offsetof(stats_t, directive_lines) },
+	};
+	char key[STATS_KEYWORD_SIZE], name[STATS_KEYWORD_SIZE];
+	unsigned long count, bytes;
+	int idx;
+
+	if(sscanf(line, "%31s", key) != 1)
+		return 0;
+
+	for(idx = 0; idx < (int)(sizeof(totals) / sizeof(totals[0])); idx++)
+	{
+		if(strcmp(key, totals[idx].key) == 0 && sscanf(line, "%*s %lu", &count) == 1)
+		{
+			*(unsigned long *)((char *)st + totals[idx].offset) += count;
+			return 1;
+		}
+	}
+
+	if(strcmp(key, "event") == 0 && sscanf(line, "%*s %31s %lu %lu", name, &count, &bytes) == 3)
+	{
+		for(idx = 0; idx < STATS_EVENT_TYPES; idx++)
+		{
+			if(event_names[idx] && strcmp(event_names[idx], name) == 0)
+			{
+				st->events[idx] += count;
+				st->event_bytes[idx] += bytes;
+			}
+		}
+		return 1;
+	}
+
+	if(strcmp(key, "keyword") == 0 && sscanf(line, "%*s %31s %lu", name, &count) == 2)
+	{
+		stats_add_keyword(st, name, count);
+		return 1;
+	}
+
+	return strcmp(key, "comment_line_ratio") == 0 || strcmp(key, "comment_byte_ratio") == 0 ||
+		   strcmp(key, "preprocessor_per_kloc") == 0;
+}
+
+/**** End of file ****/
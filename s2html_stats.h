@@ -0,0 +1,61 @@
+/*
+ * Header for lex-only source analytics.
+ *
+ * In analytics mode the source files are only run through the lexer
+ * (get_parser_event); no HTML is rendered or written. Counts are collected
+ * per file into a stats_t, per worker thread, and merged into one report.
+ *
+ * Constants:
+ * - STATS_EVENT_TYPES: Number of event types counted (all of pevent_e).
+ * - STATS_MAX_KEYWORDS: Capacity of the keyword frequency table.
+ *
+ * Structure (stats_t):
+ * - Line, byte, event and keyword counts of one or more files.
+ *
+ * Functions:
+ * - stats_init: Clears a stats_t.
+ * - stats_scan_file: Lexes one file and adds its counts.
+ * - stats_merge: Adds the counts of one stats_t to another.
+ * - stats_print: Writes the report.
+ * - stats_parse_line: Adds the counts of one report line, to combine reports.
+ */
+
+#ifndef S2HTML_STATS_H
+#define S2HTML_STATS_H
+
+#define STATS_EVENT_TYPES	(PEVENT_EOF + 1)
+#define STATS_MAX_KEYWORDS	256
+#define STATS_KEYWORD_SIZE	32
+
+typedef struct
+{
+	char name[STATS_KEYWORD_SIZE];  // keyword, empty for a free slot
+	unsigned long count;            // number of occurrences
+} stats_keyword_t;
+
+typedef struct
+{
+	unsigned long files;            // files scanned
+	unsigned long failed;           // files which could not be opened
+	unsigned long bytes;            // source bytes
+	unsigned long invalid_utf8;     // invalid UTF-8 sequences replaced with U+FFFD
+	unsigned long lines;            // all lines
+	unsigned long code_lines;       // lines with code (possibly also a comment)
+	unsigned long comment_lines;    // lines with only comments
+	unsigned long blank_lines;      // empty or whitespace only lines
+	unsigned long directive_lines;  // preprocessor directives (any, not only conditionals)
+	unsigned long events[STATS_EVENT_TYPES];       // events per type
+	unsigned long event_bytes[STATS_EVENT_TYPES];  // event data bytes per type
+	stats_keyword_t keywords[STATS_MAX_KEYWORDS];  // keyword frequency (hash table)
+} stats_t;
+
+/********** function prototypes **********/
+
+void stats_init(stats_t *st);
+int stats_scan_file(stats_t *st, const char *path);
+void stats_merge(stats_t *dst, const stats_t *src);
+void stats_print(FILE *fp, const stats_t *st);
+int stats_parse_line(stats_t *st, const char *line);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,266 @@
+/*
+ * Output Theme Functions
+ *
+ * This file holds the compiled in default theme and parses theme files into
+ * the same flat fragment table. All parsing (keys, escapes, splitting a token
+ * template at "{}") happens once at load time; the renderer only indexes the
+ * table and writes the prebuilt fragments.
+ *
+ * Main features:
+ * - theme_default: The default page and token markup (uses styles.css).
+ * - theme_load: Parses a theme file, keys that are not given keep the default.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "s2html_event.h"
+#include "s2html_theme.h"
+
+/* fragment of a string literal, its length is known at build time */
+#define THEME_FRAG(str)		{ (str), sizeof(str) - 1 }
+/* same fragment for both property slots (events without properties) */
+#define THEME_BOTH(str)		{ THEME_FRAG(str), THEME_FRAG(str) }
+
+#define THEME_ANY_SLOT		-1
+
+const theme_t theme_default = {
+	.begin = THEME_FRAG("<!DOCTYPE html>\n"
+						"<html lang=\"en-US\">\n"
+						"<head>\n"
+						"<title>source2html</title>\n"
+						"<meta charset=\"UTF-8\">\n"
+						"<link rel=\"stylesheet\" href=\"styles.css\">\n"
+						"</head>\n"
+						"<body>\n"
+						"<pre>\n"),
+	.end = THEME_FRAG("</pre>\n"
+					  "</body>\n"
+					  "</html>\n"),
+	.open = {
+		[PEVENT_PREPROCESSOR_DIRECTIVE] = THEME_BOTH("<span class=\"preprocess_dir\">"),
+		[PEVENT_RESERVE_KEYWORD]        = { THEME_FRAG("<span class=\"reserved_key1\">"),
+											THEME_FRAG("<span class=\"reserved_key2\">") },
+		[PEVENT_NUMERIC_CONSTANT]       = THEME_BOTH("<span class=\"numeric_constant\">"),
+		[PEVENT_STRING]                 = THEME_BOTH("<span class=\"string\">"),
+		[PEVENT_HEADER_FILE]            = { THEME_FRAG("<span class=\"header_file\">"),
+											THEME_FRAG("<span class=\"header_file\">&lt;") },
+		[PEVENT_REGULAR_EXP]            = THEME_BOTH(""),
+		[PEVENT_SINGLE_LINE_COMMENT]    = THEME_BOTH("<span class=\"comment\">"),
+		[PEVENT_MULTI_LINE_COMMENT]     = THEME_BOTH("<span class=\"comment\">"),
+		[PEVENT_ASCII_CHAR]             = THEME_BOTH("<span class=\"ascii_char\">"),
+		[PEVENT_INACTIVE_REGION]        = THEME_BOTH("<details class=\"inactive\"><summary>inactive</summary>"),
+		[PEVENT_EOF]                    = THEME_BOTH(""),
+	},
+	.close = {
+		[PEVENT_PREPROCESSOR_DIRECTIVE] = THEME_BOTH("</span>"),
+		[PEVENT_RESERVE_KEYWORD]        = THEME_BOTH("</span>"),
+		[PEVENT_NUMERIC_CONSTANT]       = THEME_BOTH("</span>"),
+		[PEVENT_STRING]                 = THEME_BOTH("</span>"),
+		[PEVENT_HEADER_FILE]            = { THEME_FRAG("</span>"),
+											THEME_FRAG("&gt;</span>") },
+		[PEVENT_REGULAR_EXP]            = THEME_BOTH(""),
+		[PEVENT_SINGLE_LINE_COMMENT]    = THEME_BOTH("</span>"),
+		[PEVENT_MULTI_LINE_COMMENT]     = THEME_BOTH("</span>"),
+		[PEVENT_ASCII_CHAR]             = THEME_BOTH("</span>"),
+		[PEVENT_INACTIVE_REGION]        = THEME_BOTH("</details>"),
+		[PEVENT_EOF]                    = THEME_BOTH(""),
+	},
+};
+
+/* token keys of a theme file, a key may set several table entries */
+static const struct
+{
+	const char *key;
+	pevent_e type;
+	int slot;            // property slot, THEME_ANY_SLOT for both
+} theme_keys[] = {
+	{ "preprocess_dir",   PEVENT_PREPROCESSOR_DIRECTIVE, THEME_ANY_SLOT },
+	{ "reserved_key1",    PEVENT_RESERVE_KEYWORD,        0 },
+	{ "reserved_key2",    PEVENT_RESERVE_KEYWORD,        1 },
+	{ "numeric_constant", PEVENT_NUMERIC_CONSTANT,       THEME_ANY_SLOT },
+	{ "string",           PEVENT_STRING,                 THEME_ANY_SLOT },
+	{ "header_file",      PEVENT_HEADER_FILE,            0 },
+	{ "std_header_file",  PEVENT_HEADER_FILE,            1 },
+	{ "plain",            PEVENT_REGULAR_EXP,            THEME_ANY_SLOT },
+	{ "plain",            PEVENT_EOF,                    THEME_ANY_SLOT },
+	{ "comment",          PEVENT_SINGLE_LINE_COMMENT,    THEME_ANY_SLOT },
+	{ "comment",          PEVENT_MULTI_LINE_COMMENT,     THEME_ANY_SLOT },
+	{ "ascii_char",       PEVENT_ASCII_CHAR,             THEME_ANY_SLOT },
+	{ "inactive",         PEVENT_INACTIVE_REGION,        THEME_ANY_SLOT },
+};
+
+#define THEME_KEYS	(int)(sizeof(theme_keys) / sizeof(theme_keys[0]))
+
+/* storage of the loaded theme, released when the program exits */
+static arena_t *theme_arena = NULL;
+
+/********** Utility functions **********/
+
+/* releases the loaded theme when the program exits */
+static void theme_at_exit(void)
+{
+	arena_destroy(theme_arena);
+	theme_arena = NULL;
+}
+
+/* removes leading and trailing blanks (and the line end) in place */
+static char *theme_trim(char *str)
+{
+	size_t len;
+
+	while(*str == ' ' || *str == '\t')
+		str++;
+	len = strlen(str);
+	while(len > 0 && strchr(" \t\r\n", str[len - 1]))
+		str[--len] = '\0';
+
+	return str;
+}
+
+/* resolves \n, \t and \\ in place, returns the new length */
+static size_t theme_unescape(char *str)
+{
+	char *start = str, *out = str;
+
+	for(; *str; str++)
+	{
+		if(*str == '\\' && (str[1] == 'n' || str[1] == 't' || str[1] == '\\'))
+		{
+			str++;
+			*out++ = (*str == 'n') ? '\n' : (*str == 't') ? '\t' : '\\';
+		}
+		else
+		{
+			*out++ = *str;
+		}
+	}
+	*out = '\0';
+
+	return out - start;
+}
+
+/* copies 'len' bytes into the arena as a fragment, returns -1 if out of memory */
+static int theme_frag(arena_t *arena, theme_frag_t *frag, const char *text, size_t len)
+{
+	char *copy;
+
+	if(NULL == (copy = arena_strndup(arena, text, len)))
+		return -1;
+	frag->text = copy;
+	frag->len = len;
+
+	return 0;
+}
+
+/* sets the entries of a token key, returns 0, -1 if out of memory, 1 if the key or template is invalid */
+static int theme_set_token(theme_t *theme, arena_t *arena, const char *key, const char *value, size_t len)
+{
+	const char *mark = strstr(value, "{}");
+	theme_frag_t open, close;
+	int idx, slot, found = 0;
+
+	if(mark == NULL)
+		return 1;
+	if(theme_frag(arena, &open, value, mark - value) != 0 ||
+	   theme_frag(arena, &close, mark + 2, len - (mark - value) - 2) != 0)
+		return -1;
+
+	for(idx = 0; idx < THEME_KEYS; idx++)
+	{
+		if(strcmp(theme_keys[idx].key, key) != 0)
+			continue;
+		found = 1;
+		for(slot = 0; slot < THEME_PROPERTIES; slot++)
+		{
+			if(theme_keys[idx].slot != THEME_ANY_SLOT && theme_keys[idx].slot != slot)
+				continue;
+			theme->open[theme_keys[idx].type][slot] = open;
+			theme->close[theme_keys[idx].type][slot] = close;
+		}
+	}
+
+	return found ? 0 : 1;
+}
+
+/************ Theme functions **********/
+
+/* Parses the theme file 'path' into *theme, starting from the default theme.
+ * The theme stays valid for the rest of the program, only one theme can be
+ * loaded. Returns 0 on success, -1 if the file could not be read (or out of
+ * memory, or a theme is already loaded), or the number of the first invalid
+ * line.
+ */
+int theme_load(const char *path, const theme_t **theme)
+{
+	arena_t *arena;
+	theme_t *loaded;
+	char *line = NULL, *key, *value, *eq;
+	size_t line_size = 0, len;
+	int line_no = 0, ret = 0;
+	FILE *fp;
+
+	if(NULL == (fp = fopen(path, "r")))
+		return -1;
+
+	if(NULL == (arena = arena_create()) ||
+	   NULL == (loaded = arena_alloc(arena, ARENA_CLASS_RECORD, sizeof(theme_t))))
+	{
+		arena_destroy(arena);
+		fclose(fp);
+		return -1;
+	}
+	*loaded = theme_default;
+
+	while(ret == 0 && getline(&line, &line_size, fp) != -1)
+	{
+		line_no++;
+		key = theme_trim(line);
+		if(key[0] == '\0' || key[0] == '#')
+			continue;
+
+		if(NULL == (eq = strchr(key, '=')))
+		{
+			ret = line_no;
+			break;
+		}
+		*eq = '\0';
+		key = theme_trim(key);
+		value = theme_trim(eq + 1);
+		len = theme_unescape(value);
+
+		if(strcmp(key, "begin") == 0)
+			ret = theme_frag(arena, &loaded->begin, value, len);
+		else if(strcmp(key, "end") == 0)
+			ret = theme_frag(arena, &loaded->end, value, len);
+		else
+			ret = theme_set_token(loaded, arena, key, value, len);
+
+		if(ret > 0)
+			ret = line_no;
+	}
+
+	free(line);
+	if(ret == 0 && (ferror(fp) || !feof(fp)))
+		ret = -1;
+	fclose(fp);
+
+	if(ret != 0)
+	{
+		arena_destroy(arena);
+		return ret;
+	}
+
+	/* one theme is loaded at startup, it is used until the program exits */
+	if(theme_arena != NULL || atexit(theme_at_exit) != 0)
+	{
+		arena_destroy(arena);
+		return -1;
+	}
+	theme_arena = arena;
+	*theme = loaded;
+
+	return 0;
+}
+
+/**** End of file ****/
@@ -0,0 +1,60 @@
+/*
+ * Header for output themes.
+ *
+ * A theme holds all markup written around the source: the page before and
+ * after the code and, for every event type and property, the bytes written
+ * before and after the token text. It is compiled once into a flat table of
+ * prebuilt fragments, so rendering a token only indexes the table. The
+ * default theme is compiled in; a theme file is parsed once at startup and
+ * shared (read only) by all conversions.
+ *
+ * Theme file format, one "key = value" per line ('#' starts a comment line):
+ *   begin / end     Page before / after the code.
+ *   <token class>   Markup of a token with "{}" marking the token text, e.g.
+ *                   comment = <span class="comment">{}</span>
+ * Values may use \n, \t and \\. Keys that are not given keep the default.
+ *
+ * Constants:
+ * - THEME_PROPERTIES: Property slots per event type.
+ *
+ * Structures:
+ * - theme_frag_t: A prebuilt fragment (text and length).
+ * - theme_t: The fragment table of a theme.
+ *
+ * Functions:
+ * - theme_load: Parses a theme file into a fragment table.
+ */
+
+#ifndef S2HTML_THEME_H
+#define S2HTML_THEME_H
+
+#include <stddef.h>
+
+/* slot 0: user header file / data type keyword (and events without property)
+ * slot 1: standard header file / other keyword
+ */
+#define THEME_PROPERTIES	2
+#define THEME_SLOT(property)	((property) == STD_HEADER_FILE || (property) == RES_KEYWORD_NON_DATA)
+
+typedef struct
+{
+	const char *text;
+	size_t len;
+} theme_frag_t;
+
+typedef struct
+{
+	theme_frag_t begin;    // page before the code
+	theme_frag_t end;      // page after the code
+	theme_frag_t open[PEVENT_EOF + 1][THEME_PROPERTIES];   // before the token text
+	theme_frag_t close[PEVENT_EOF + 1][THEME_PROPERTIES];  // after the token text
+} theme_t;
+
+extern const theme_t theme_default;
+
+/********** function prototypes **********/
+
+int theme_load(const char *path, const theme_t **theme);
+
+#endif
+/**** End of file ****/
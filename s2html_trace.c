@@ -0,0 +1,320 @@
+/*
+ * Pipeline Tracing Functions
+ *
+ * This file records spans into per thread buffers and writes them as
+ * Chrome trace-event JSON ("X" complete events, one track per thread).
+ * A thread takes a lock only once, to register its buffer; recording a span
+ * only appends to the thread's own buffer. The buffer of a thread which ended
+ * is taken over by the next new thread, so worker threads started per batch
+ * reuse a few tracks instead of adding one each.
+ *
+ * Every flush appends the spans recorded since the previous one to the trace
+ * file and frees them, so a long watch run keeps only one burst in memory.
+ * The file is closed with "]}" after each flush, which the next flush
+ * overwrites, so it is valid JSON whenever the program is stopped.
+ *
+ * Main features:
+ * - trace_start / trace_flush: Enables tracing and writes the trace file.
+ * - trace_begin / trace_end: Record one span (used through TRACE_BEGIN/END).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "s2html_trace.h"
+
+#define TRACE_BLOCK_EVENTS	4096
+
+/* one finished span */
+typedef struct
+{
+	const char *name;
+	char detail[TRACE_DETAIL_SIZE];
+	unsigned long long start;       // ns
+	unsigned long long dur;         // ns
+} trace_event_t;
+
+/* block of recorded spans, a thread's buffer grows block by block */
+typedef struct trace_block
+{
+	struct trace_block *next;
+	int count;
+	trace_event_t events[TRACE_BLOCK_EVENTS];
+} trace_block_t;
+
+/* spans of one thread */
+typedef struct trace_buffer
+{
+	struct trace_buffer *next;      // all registered buffers
+	int tid;                        // track number in the trace
+	int in_use;                     // owned by a running thread
+	int named;                      // its thread name was written
+	trace_block_t *first, *last;
+} trace_buffer_t;
+
+int trace_enabled = 0;
+
+static const char *trace_path = NULL;
+static FILE *trace_fp = NULL;               // trace file, open after the first flush
+static long trace_tail = 0;                 // offset of the closing "]}" in it
+static const char *trace_sep = "";          // written before the next entry of the file
+static unsigned long long trace_epoch = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer_t *trace_buffers = NULL;
+static int trace_threads = 0;
+static __thread trace_buffer_t *thread_buffer = NULL;
+static pthread_key_t trace_thread_key;      // releases the buffer of an ending thread
+
+/********** Utility functions **********/
+
+/* monotonic time in ns */
+static unsigned long long trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* hands the buffer of an ending thread back for the next new thread */
+static void trace_release_buffer(void *arg)
+{
+	trace_buffer_t *buf = arg;
+
+	pthread_mutex_lock(&trace_lock);
+	buf->in_use = 0;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+/* returns the calling thread's buffer, taking over a released one or
+ * registering a new one on first use
+ */
+static trace_buffer_t *trace_thread_buffer(void)
+{
+	trace_buffer_t *buf = thread_buffer;
+
+	if(buf != NULL)
+		return buf;
+
+	pthread_mutex_lock(&trace_lock);
+	for(buf = trace_buffers; buf != NULL && buf->in_use; buf = buf->next)
+		;
+	if(buf == NULL && NULL != (buf = calloc(1, sizeof(trace_buffer_t))))
+	{
+		buf->tid = ++trace_threads;
+		buf->next = trace_buffers;
+		trace_buffers = buf;
+	}
+	if(buf != NULL)
+		buf->in_use = 1;
+	pthread_mutex_unlock(&trace_lock);
+
+	if(buf == NULL)
+		return NULL;
+
+	thread_buffer = buf;
+	pthread_setspecific(trace_thread_key, buf);
+
+	return buf;
+}
+
+/* frees the recorded spans of a buffer, the caller holds trace_lock */
+static void trace_free_blocks(trace_buffer_t *buf)
+{
+	trace_block_t *block, *next_block;
+
+	for(block = buf->first; block != NULL; block = next_block)
+	{
+		next_block = block->next;
+		free(block);
+	}
+	buf->first = NULL;
+	buf->last = NULL;
+}
+
+/* frees all buffers, after the last flush */
+static void trace_free(void)
+{
+	trace_buffer_t *buf, *next_buf;
+
+	pthread_mutex_lock(&trace_lock);
+	for(buf = trace_buffers; buf != NULL; buf = next_buf)
+	{
+		next_buf = buf->next;
+		trace_free_blocks(buf);
+		free(buf);
+	}
+	trace_buffers = NULL;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+/* writes a string as JSON string contents */
+static void trace_write_string(FILE *fp, const char *str)
+{
+	for(; *str; str++)
+	{
+		if(*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if((unsigned char)*str < 0x20)
+			fprintf(fp, "\\u%04x", (unsigned char)*str);
+		else
+			fputc(*str, fp);
+	}
+}
+
+/* writes the trace when the program exits */
+static void trace_at_exit(void)
+{
+	trace_flush();
+
+	/* spans of threads still running at exit are dropped */
+	trace_enabled = 0;
+	thread_buffer = NULL;
+	trace_free();
+	if(trace_fp != NULL)
+		fclose(trace_fp);
+	trace_fp = NULL;
+}
+
+/************ Trace functions **********/
+
+/* Enables tracing. The trace is written to 'path' by trace_flush(), which
+ * is also run at exit. Returns 0 on success.
+ */
+int trace_start(const char *path)
+{
+	if(pthread_key_create(&trace_thread_key, trace_release_buffer) != 0)
+		return -1;
+
+	trace_path = path;
+	trace_epoch = trace_now();
+	trace_enabled = 1;
+
+	/* the calling (main) thread becomes track 1 */
+	trace_thread_buffer();
+
+	return atexit(trace_at_exit);
+}
+
+/* Starts a span, 'detail' is copied when the span ends (only its end if it is long). */
+void trace_begin(trace_span_t *span, const char *name, const char *detail)
+{
+	span->name = name;
+	span->detail = detail;
+	span->start = trace_now();
+}
+
+/* Ends a span and appends it to the calling thread's buffer. */
+void trace_end(trace_span_t *span)
+{
+	unsigned long long end = trace_now();
+	trace_buffer_t *buf = trace_thread_buffer();
+	trace_block_t *block;
+	trace_event_t *ev;
+
+	if(buf == NULL)
+		return;
+
+	block = buf->last;
+	if(block == NULL || block->count == TRACE_BLOCK_EVENTS)
+	{
+		if(NULL == (block = malloc(sizeof(trace_block_t))))
+			return;
+		block->next = NULL;
+		block->count = 0;
+		if(buf->last)
+			buf->last->next = block;
+		else
+			buf->first = block;
+		buf->last = block;
+	}
+
+	ev = &block->events[block->count];
+	ev->name = span->name;
+	ev->detail[0] = '\0';
+	if(span->detail)
+	{
+		size_t len = strlen(span->detail);
+		const char *tail = span->detail + (len >= sizeof(ev->detail) ? len - sizeof(ev->detail) + 1 : 0);
+
+		while((*tail & 0xC0) == 0x80) // do not start inside a UTF-8 character
+			tail++;
+		memcpy(ev->detail, tail, strlen(tail) + 1);
+	}
+	ev->start = span->start - trace_epoch;
+	ev->dur = end - span->start;
+
+	/* publish after the event is complete */
+	__atomic_store_n(&block->count, block->count + 1, __ATOMIC_RELEASE);
+}
+
+/* Appends the spans recorded since the last flush to the trace file as
+ * Chrome trace-event JSON and frees them. Call while no other thread records
+ * spans. Returns 0 on success, -1 on error.
+ */
+int trace_flush(void)
+{
+	trace_buffer_t *buf;
+	trace_block_t *block;
+	FILE *fp = trace_fp;
+	int idx, count;
+
+	if(!trace_enabled)
+		return -1;
+
+	/* the first flush starts the file, later ones replace its closing "]}" */
+	if(fp == NULL)
+	{
+		if(NULL == (fp = trace_fp = fopen(trace_path, "w")))
+			return -1;
+		fprintf(fp, "{\"traceEvents\":[\n");
+	}
+	else if(fseek(fp, trace_tail, SEEK_SET) != 0)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	for(buf = trace_buffers; buf != NULL; buf = buf->next)
+	{
+		if(!buf->named)
+		{
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+					"\"args\":{\"name\":\"%s %d\"}}", trace_sep, buf->tid, buf->tid == 1 ? "main" : "worker", buf->tid);
+			trace_sep = ",\n";
+			buf->named = 1;
+		}
+
+		for(block = buf->first; block != NULL; block = block->next)
+		{
+			count = __atomic_load_n(&block->count, __ATOMIC_ACQUIRE);
+			for(idx = 0; idx < count; idx++)
+			{
+				trace_event_t *ev = &block->events[idx];
+
+				fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"s2html\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+						"\"ts\":%.3f,\"dur\":%.3f", trace_sep, ev->name, buf->tid, ev->start / 1000.0, ev->dur / 1000.0);
+				if(ev->detail[0])
+				{
+					fprintf(fp, ",\"args\":{\"file\":\"");
+					trace_write_string(fp, ev->detail);
+					fprintf(fp, "\"}");
+				}
+				fprintf(fp, "}");
+				trace_sep = ",\n";
+			}
+		}
+		trace_free_blocks(buf);
+	}
+	pthread_mutex_unlock(&trace_lock);
+
+	trace_tail = ftell(fp);
+	fprintf(fp, "\n]}\n");
+
+	return (fflush(fp) == 0 && !ferror(fp)) ? 0 : -1;
+}
+
+/**** End of file ****/
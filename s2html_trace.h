@@ -0,0 +1,47 @@
+/*
+ * Header for pipeline tracing.
+ *
+ * When tracing is enabled, the stages of a conversion (open, lex, render,
+ * close, ...) are recorded as spans into per thread buffers without locks,
+ * and written as Chrome trace-event JSON which chrome://tracing and Perfetto
+ * can load. With tracing disabled every span costs one predictable branch.
+ *
+ * Types:
+ * - trace_span_t: A span in progress (name, detail and start time).
+ *
+ * Macros:
+ * - TRACE_BEGIN / TRACE_END: Record a span if tracing is enabled.
+ *
+ * Functions:
+ * - trace_start: Enables tracing, the trace is written to the given file.
+ * - trace_flush: Appends the spans recorded since the last flush and frees them.
+ */
+
+#ifndef S2HTML_TRACE_H
+#define S2HTML_TRACE_H
+
+#define TRACE_DETAIL_SIZE	48
+
+typedef struct
+{
+	const char *name;               // stage, a string literal
+	const char *detail;             // e.g. file name, may be NULL
+	unsigned long long start;       // start time in ns
+} trace_span_t;
+
+extern int trace_enabled;
+
+#define TRACE_BEGIN(span, span_name, span_detail) \
+	do { if(__builtin_expect(trace_enabled, 0)) trace_begin(&(span), (span_name), (span_detail)); } while(0)
+#define TRACE_END(span) \
+	do { if(__builtin_expect(trace_enabled, 0)) trace_end(&(span)); } while(0)
+
+/********** function prototypes **********/
+
+int trace_start(const char *path);
+int trace_flush(void);
+void trace_begin(trace_span_t *span, const char *name, const char *detail);
+void trace_end(trace_span_t *span);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,365 @@
+/*
+ * UTF-8 Validation Functions
+ *
+ * This file validates source buffers as UTF-8 (RFC 3629: no overlong forms,
+ * no surrogates, nothing above U+10FFFF). Pure ASCII runs are skipped with
+ * SSE2 (64 bytes per step) or word-at-a-time checks on other targets, so
+ * ASCII sources cost little more than reading the memory once. Multibyte
+ * sequences are checked one at a time.
+ *
+ * Main features:
+ * - utf8_validate: Counts invalid sequences in a buffer.
+ * - utf8_repair: Replaces every invalid sequence (maximal invalid subpart)
+ *   with U+FFFD.
+ * - utf8_source_open / utf8_source_close: Map (or read), validate and lex a
+ *   source from memory.
+*/
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "s2html_utf8.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* regular files are mapped (1) or read into memory (0) */
+static int utf8_mapping = 1;
+
+/********** Utility functions **********/
+
+/* returns the length of the pure ASCII run at the start of buf */
+static size_t utf8_ascii_prefix(const unsigned char *buf, size_t len)
+{
+    size_t idx = 0;
+
+#if defined(__SSE2__)
+    /* 64 bytes per step, the high bit of any byte marks non ASCII */
+    while (idx + 64 <= len)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(buf + idx));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(buf + idx + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(buf + idx + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(buf + idx + 48));
+
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3))))
+            break;
+        idx += 64;
+    }
+    while (idx + 16 <= len)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + idx)));
+
+        if (mask)
+            return idx + __builtin_ctz(mask);
+        idx += 16;
+    }
+#else
+    /* word at a time */
+    while (idx + 8 <= len)
+    {
+        uint64_t word;
+
+        memcpy(&word, buf + idx, sizeof(word));
+        if (word & 0x8080808080808080ULL)
+            break;
+        idx += 8;
+    }
+#endif
+
+    while (idx < len && buf[idx] < 0x80)
+        idx++;
+
+    return idx;
+}
+
+/* checks the multibyte sequence at buf, sets *used to its length if valid
+ * (returns 1) or to the length of its maximal invalid subpart (returns 0)
+ */
+static int utf8_sequence(const unsigned char *buf, size_t len, size_t *used)
+{
+    unsigned char lead = buf[0];
+    unsigned char lo = 0x80, hi = 0xBF; // allowed range of the first continuation byte
+    size_t need, idx;
+
+    if (lead >= 0xC2 && lead <= 0xDF)
+        need = 1;
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        need = 2;
+        if (lead == 0xE0)
+            lo = 0xA0;  // overlong
+        else if (lead == 0xED)
+            hi = 0x9F;  // surrogates
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        need = 3;
+        if (lead == 0xF0)
+            lo = 0x90;  // overlong
+        else if (lead == 0xF4)
+            hi = 0x8F;  // above U+10FFFF
+    }
+    else
+    {
+        *used = 1; // continuation byte without lead, or invalid lead byte
+        return 0;
+    }
+
+    for (idx = 1; idx <= need; idx++)
+    {
+        if (idx >= len || buf[idx] < lo || buf[idx] > hi)
+        {
+            *used = idx;
+            return 0;
+        }
+        lo = 0x80;
+        hi = 0xBF;
+    }
+
+    *used = need + 1;
+    return 1;
+}
+
+/************ Validation functions **********/
+
+/* Returns the number of invalid UTF-8 sequences in buf, 0 if it is valid. */
+size_t utf8_validate(const unsigned char *buf, size_t len)
+{
+    size_t idx = 0, used, invalid = 0;
+
+    while (idx < len)
+    {
+        idx += utf8_ascii_prefix(buf + idx, len - idx);
+        if (idx >= len)
+            break;
+
+        if (!utf8_sequence(buf + idx, len - idx, &used))
+            invalid++;
+        idx += used;
+    }
+
+    return invalid;
+}
+
+/* Copies buf into out, replacing every invalid sequence with U+FFFD. 'out'
+ * must hold UTF8_REPAIR_SIZE(len) bytes. Returns the length of the copy and
+ * stores the number of replaced sequences in *invalid.
+ */
+size_t utf8_repair(const unsigned char *buf, size_t len, unsigned char *out, size_t *invalid)
+{
+    size_t idx = 0, out_len = 0, run, used;
+
+    *invalid = 0;
+    while (idx < len)
+    {
+        /* ASCII runs are copied in bulk */
+        run = utf8_ascii_prefix(buf + idx, len - idx);
+        memcpy(out + out_len, buf + idx, run);
+        out_len += run;
+        idx += run;
+        if (idx >= len)
+            break;
+
+        if (utf8_sequence(buf + idx, len - idx, &used))
+        {
+            memcpy(out + out_len, buf + idx, used);
+            out_len += used;
+        }
+        else
+        {
+            memcpy(out + out_len, UTF8_REPLACEMENT, sizeof(UTF8_REPLACEMENT) - 1);
+            out_len += sizeof(UTF8_REPLACEMENT) - 1;
+            (*invalid)++;
+        }
+        idx += used;
+    }
+
+    return out_len;
+}
+
+/************ Source functions **********/
+
+/* opens a memory buffer for reading by the calling thread; memory streams
+ * always lock per call, which would cost more than the lexing itself
+ */
+static FILE *utf8_memopen(unsigned char *data, size_t len)
+{
+    FILE *fp = fmemopen(data, len, "r");
+
+    if (fp != NULL)
+        __fsetlocking(fp, FSETLOCKING_BYCALLER);
+
+    return fp;
+}
+
+/* reads the rest of an open file into memory, the buffer is allocated even
+ * for an empty file. Returns NULL if out of memory or on a read error.
+ */
+static unsigned char *utf8_read_all(int fd, size_t *len)
+{
+    unsigned char *buf = NULL, *grown;
+    size_t size = 0;
+    ssize_t got;
+
+    *len = 0;
+    do
+    {
+        if (*len == size)
+        {
+            size = size ? size * 2 : UTF8_READ_SIZE;
+            if (NULL == (grown = realloc(buf, size)))
+            {
+                free(buf);
+                return NULL;
+            }
+            buf = grown;
+        }
+        got = read(fd, buf + *len, size - *len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+        {
+            free(buf);
+            return NULL;
+        }
+        *len += got;
+    } while (got > 0);
+
+    return buf;
+}
+
+/* Opens a source held in memory for lexing by the calling thread: valid
+ * data is read as it is, otherwise from a repaired copy. 'data' must stay
+ * until utf8_source_close(). Returns NULL if out of memory.
+ */
+FILE *utf8_source_open_data(utf8_source_t *src, unsigned char *data, size_t len)
+{
+    size_t repaired_len;
+    FILE *fp;
+
+    src->data = data;
+    src->len = len;
+    src->map = NULL;
+    src->map_len = 0;
+    src->read = NULL;
+    src->read_len = 0;
+    src->repaired = NULL;
+    if ((src->invalid = utf8_validate(data, len)) == 0)
+        return utf8_memopen(data, len);
+
+    if (NULL == (src->repaired = malloc(UTF8_REPAIR_SIZE(len))))
+        return NULL;
+    repaired_len = utf8_repair(data, len, src->repaired, &src->invalid);
+
+    if (NULL == (fp = utf8_memopen(src->repaired, repaired_len)))
+    {
+        free(src->repaired);
+        src->repaired = NULL;
+        return NULL;
+    }
+    src->data = src->repaired;
+    src->len = repaired_len;
+
+    return fp;
+}
+
+/* Opens the file at 'path' for lexing. Regular files are mapped, validated
+ * and lexed from the mapping (or a repaired copy); other files (pipes, empty
+ * files) and all files while mapping is off are read into memory first.
+ * Returns NULL if the file could not be opened or read.
+ */
+FILE *utf8_source_open(utf8_source_t *src, const char *path)
+{
+    struct stat st, now;
+    unsigned char *map, *buf;
+    size_t len;
+    FILE *fp;
+    int fd;
+
+    memset(src, 0, sizeof(*src));
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    if (utf8_mapping && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+    {
+        /* the file is read front to back once */
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        if (NULL == (fp = utf8_source_open_data(src, map, st.st_size)))
+        {
+            munmap(map, st.st_size);
+            close(fd);
+            return NULL;
+        }
+        src->map = map;
+        src->map_len = st.st_size;
+
+        /* pages cut off by a truncation fault (SIGBUS) when lexed, read what is left
+         * then; a repaired copy is lexed instead of the mapping and is safe
+         */
+        if (src->repaired != NULL || (fstat(fd, &now) == 0 && now.st_size >= st.st_size))
+        {
+            close(fd);
+            return fp;
+        }
+        utf8_source_close(src, fp);
+        memset(src, 0, sizeof(*src));
+        lseek(fd, 0, SEEK_SET);
+    }
+
+    buf = utf8_read_all(fd, &len);
+    close(fd);
+    if (buf == NULL)
+        return NULL;
+    if (NULL == (fp = utf8_source_open_data(src, buf, len)))
+    {
+        free(buf);
+        return NULL;
+    }
+    src->read = buf;
+    src->read_len = len;
+
+    return fp;
+}
+
+/* Closes a stream opened by utf8_source_open(_data) and releases the
+ * mapping, read buffer and repaired copy behind it, src->invalid is kept.
+ */
+void utf8_source_close(utf8_source_t *src, FILE *fp)
+{
+    fclose(fp);
+    if (src->map != NULL)
+        munmap(src->map, src->map_len);
+    free(src->read);
+    free(src->repaired);
+    src->map = NULL;
+    src->read = NULL;
+    src->repaired = NULL;
+    src->data = NULL;
+}
+
+/* Selects whether regular files are mapped (non zero, the default) or read
+ * into memory, e.g. while they may be truncated by an editor saving them.
+ */
+void utf8_set_mapping(int mapping)
+{
+    utf8_mapping = mapping;
+}
+
+/**** End of file ****/
@@ -0,0 +1,65 @@
+/*
+ * Header for UTF-8 validation of source files.
+ *
+ * Source files are validated once before lexing. Valid files (the common
+ * case) are passed through in bulk; files with invalid sequences (stray
+ * Latin-1 bytes, truncated characters) are repaired by replacing every
+ * invalid sequence with U+FFFD.
+ *
+ * Sources are opened for lexing through utf8_source_open(), which maps the
+ * file, validates the mapping and lexes straight from it (or from the
+ * repaired copy), so the file is read only once. Files which cannot be
+ * mapped (pipes, empty files) or may shrink while they are lexed (watch
+ * mode) are read into memory instead.
+ *
+ * Constants:
+ * - UTF8_REPLACEMENT: Encoding of U+FFFD REPLACEMENT CHARACTER.
+ * - UTF8_REPAIR_SIZE: Worst case size of a repaired copy of 'len' bytes.
+ * - UTF8_TAIL_LEN: Continuation bytes following a (valid) lead byte.
+ * - UTF8_READ_SIZE: First buffer size for files read into memory.
+ *
+ * Structure (utf8_source_t):
+ * - A source opened for lexing and the memory behind its stream.
+ *
+ * Functions:
+ * - utf8_validate: Counts invalid sequences, vectorized for ASCII runs.
+ * - utf8_repair: Copies a buffer replacing invalid sequences.
+ * - utf8_source_open / utf8_source_open_data: Validate a file or buffer and open it for lexing.
+ * - utf8_source_close: Closes the stream and releases its memory.
+ * - utf8_set_mapping: Selects whether regular files are mapped or read.
+ */
+
+#ifndef S2HTML_UTF8_H
+#define S2HTML_UTF8_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define UTF8_REPLACEMENT		"\xEF\xBF\xBD"
+#define UTF8_REPAIR_SIZE(len)	((len) * 3)
+#define UTF8_TAIL_LEN(lead)		((lead) >= 0xF0 ? 3 : (lead) >= 0xE0 ? 2 : 1)
+#define UTF8_READ_SIZE			(64 * 1024)
+
+typedef struct
+{
+    const unsigned char *data;  // bytes lexed (valid or repaired)
+    size_t len;
+    size_t invalid;             // replaced sequences
+    unsigned char *map;         // mapping of the file, NULL if not mapped
+    size_t map_len;
+    unsigned char *read;        // file read into memory, NULL if mapped
+    size_t read_len;
+    unsigned char *repaired;    // repaired copy, NULL if the source is valid
+} utf8_source_t;
+
+/********** function prototypes **********/
+
+size_t utf8_validate(const unsigned char *buf, size_t len);
+size_t utf8_repair(const unsigned char *buf, size_t len, unsigned char *out, size_t *invalid);
+FILE *utf8_source_open(utf8_source_t *src, const char *path);
+FILE *utf8_source_open_data(utf8_source_t *src, unsigned char *data, size_t len);
+void utf8_source_close(utf8_source_t *src, FILE *fp);
+void utf8_set_mapping(int mapping);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,236 @@
+/*
+ * Watch Mode Functions
+ *
+ * This file watches source files (or whole directories) with inotify and
+ * hands changed files to a conversion callback. A file counts as changed
+ * when it is closed after writing or renamed into place, which covers
+ * editors that save through a temporary file.
+ *
+ * Events are collected until no new event arrived for WATCH_DEBOUNCE_MS, then
+ * the burst is converted at once. Paths of a burst are kept in an arena which
+ * is reset afterwards.
+ *
+ * Main features:
+ * - watch_run: Event loop collecting, debouncing and converting changes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "s2html_arena.h"
+#include "s2html_watch.h"
+
+#define WATCH_MASK			(IN_CLOSE_WRITE | IN_MOVED_TO)
+#define WATCH_EVENT_BUFF	(64 * 1024)
+
+/* one watched argument */
+typedef struct
+{
+    int wd;              // inotify watch of the directory
+    char *dir;           // directory, "." for the current one
+    const char *name;    // watched file name, NULL to watch all files of dir
+} watch_entry_t;
+
+/* changed files of the current burst */
+typedef struct
+{
+    arena_t *arena;
+    char *files[WATCH_MAX_PENDING];
+    int nfiles;
+} watch_pending_t;
+
+/* names which are never converted: our own output and editor temporaries */
+static const char *skip_suffixes[] = { ".html", ".html.gz", ".css", "~", ".swp", ".swx", ".tmp", "" };
+
+/********** Utility functions **********/
+
+/* checks whether a changed file in a watched directory should be converted */
+static int watch_is_source(const char *name)
+{
+    size_t len = strlen(name), suffix_len;
+    int idx;
+
+    if (name[0] == '.' || strcmp(name, "4913") == 0) // hidden files, vim's write test file
+        return 0;
+
+    for (idx = 0; *skip_suffixes[idx]; idx++)
+    {
+        suffix_len = strlen(skip_suffixes[idx]);
+        if (len >= suffix_len && strcmp(name + len - suffix_len, skip_suffixes[idx]) == 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* adds a changed file to the burst unless it is already pending */
+static void watch_add_pending(watch_pending_t *pending, const char *dir, const char *name)
+{
+    char path[FILENAME_MAX];
+    int idx;
+
+    if (strcmp(dir, ".") == 0)
+        snprintf(path, sizeof(path), "%s", name);
+    else
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    for (idx = 0; idx < pending->nfiles; idx++)
+    {
+        if (strcmp(pending->files[idx], path) == 0)
+            return;
+    }
+
+    if (pending->nfiles < WATCH_MAX_PENDING)
+    {
+        char *copy = arena_strndup(pending->arena, path, strlen(path));
+
+        if (copy != NULL)
+            pending->files[pending->nfiles++] = copy;
+    }
+}
+
+/* reads all available inotify events and collects the changed files */
+static int watch_read_events(int fd, watch_entry_t *entries, int nentries, watch_pending_t *pending)
+{
+    char buff[WATCH_EVENT_BUFF] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t len;
+    char *ptr;
+    int idx;
+
+    if ((len = read(fd, buff, sizeof(buff))) <= 0)
+        return -1;
+
+    for (ptr = buff; ptr < buff + len; ptr += sizeof(struct inotify_event) + ev->len)
+    {
+        ev = (const struct inotify_event *)ptr;
+        if (ev->len == 0 || (ev->mask & IN_ISDIR))
+            continue;
+
+        for (idx = 0; idx < nentries; idx++)
+        {
+            if (entries[idx].wd != ev->wd)
+                continue;
+            if (entries[idx].name ? strcmp(entries[idx].name, ev->name) == 0 : watch_is_source(ev->name))
+            {
+                watch_add_pending(pending, entries[idx].dir, ev->name);
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/************ Watch functions **********/
+
+/* Watches the given files and directories (not recursively) and calls
+ * 'convert' with the files changed in each burst of events. Runs until the
+ * process is stopped; returns non zero if watching failed.
+ */
+int watch_run(char **paths, int npaths, watch_convert_fn convert)
+{
+    watch_entry_t *entries;
+    watch_pending_t pending;
+    struct pollfd pfd;
+    struct stat st;
+    int fd, idx, ret = 0;
+
+    if ((fd = inotify_init1(IN_CLOEXEC)) < 0)
+    {
+        printf("Error!!! Could Not Initialize File Watching\n");
+        return 6;
+    }
+
+    entries = calloc(npaths, sizeof(watch_entry_t));
+    pending.arena = arena_acquire();
+    pending.nfiles = 0;
+    if (entries == NULL || pending.arena == NULL)
+    {
+        printf("Error!!! Out Of Memory\n");
+        close(fd);
+        free(entries);
+        return 5;
+    }
+
+    /* files are watched through their directory, so renames into place are seen */
+    for (idx = 0; idx < npaths; idx++)
+    {
+        watch_entry_t *entry = &entries[idx];
+        char *slash;
+
+        if (stat(paths[idx], &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            entry->dir = strdup(paths[idx]);
+            entry->name = NULL;
+        }
+        else if ((slash = strrchr(paths[idx], '/')) != NULL)
+        {
+            entry->dir = strndup(paths[idx], slash - paths[idx] + (slash == paths[idx]));
+            entry->name = slash + 1;
+        }
+        else
+        {
+            entry->dir = strdup(".");
+            entry->name = paths[idx];
+        }
+
+        if (entry->dir == NULL || (entry->wd = inotify_add_watch(fd, entry->dir, WATCH_MASK)) < 0)
+        {
+            printf("Error!!! Could Not Watch %s\n", paths[idx]);
+            entry->wd = -1;
+            ret = 6;
+        }
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    printf("\nWatching %d Path(s) For Changes\n\n", npaths);
+    fflush(stdout);
+
+    while (ret == 0)
+    {
+        /* wait for the first event of a burst */
+        if (poll(&pfd, 1, -1) < 0 || watch_read_events(fd, entries, npaths, &pending) != 0)
+            break;
+
+        /* merge everything which follows closely */
+        while (poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0)
+        {
+            if (watch_read_events(fd, entries, npaths, &pending) != 0)
+                break;
+        }
+
+        /* temporary files renamed away during the burst are gone by now */
+        for (idx = 0; idx < pending.nfiles; )
+        {
+            if (stat(pending.files[idx], &st) == 0 && S_ISREG(st.st_mode))
+                idx++;
+            else
+                pending.files[idx] = pending.files[--pending.nfiles];
+        }
+
+        if (pending.nfiles > 0)
+        {
+            convert(pending.files, pending.nfiles);
+            fflush(stdout);
+        }
+
+        pending.nfiles = 0;
+        arena_reset(pending.arena);
+    }
+
+    for (idx = 0; idx < npaths; idx++)
+        free(entries[idx].dir);
+    free(entries);
+    arena_release(pending.arena);
+    close(fd);
+
+    return ret;
+}
+
+/**** End of file ****/
@@ -0,0 +1,33 @@
+/*
+ * Header for watch mode.
+ *
+ * Watch mode keeps running and re-converts source files as soon as they are
+ * saved. Bursts of file system events (e.g. editors saving through a
+ * temporary file and rename) are merged, and every changed file of a burst
+ * is converted once, in parallel.
+ *
+ * Constants:
+ * - WATCH_DEBOUNCE_MS: Quiet time which ends a burst of events.
+ * - WATCH_MAX_PENDING: Most files converted per burst.
+ *
+ * Types:
+ * - watch_convert_fn: Called with the changed files of one burst.
+ *
+ * Functions:
+ * - watch_run: Watches files and directories until an error occurs.
+ */
+
+#ifndef S2HTML_WATCH_H
+#define S2HTML_WATCH_H
+
+#define WATCH_DEBOUNCE_MS	30
+#define WATCH_MAX_PENDING	1024
+
+typedef void (*watch_convert_fn)(char **files, int nfiles);
+
+/********** function prototypes **********/
+
+int watch_run(char **paths, int npaths, watch_convert_fn convert);
+
+#endif
+/**** End of file ****/
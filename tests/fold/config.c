@@ -0,0 +1,36 @@
+/* conditionals folded with -D CONFIG_NET -D DEBUG=0, live code is only
+ * comments here so that the expected output shows the folding alone */
+
+#ifdef CONFIG_NET
+/* live: CONFIG_NET is defined */
+#else
+int net_enabled = 0; /* a <b> & c */
+#endif
+
+#if DEBUG
+static void trace(const char *msg) { if (msg && *msg) printf("<%s>\n", msg); }
+  # if nested
+  int x = a < b && b > c;
+  # endif
+#elif !defined(CONFIG_NET) || 0
+int fallback;
+#else
+/* live: the last branch, quiet = 1 < 2 && 2 > 1 */
+#endif
+
+#ifndef CONFIG_NET
+const char *s = "#endif inside a literal & <tag>";
+// #else in a comment
+#endif
+
+    #if 0
+    char *p = "x" & y;
+    #endif
+	#ifndef UNKNOWN_MACRO
+/* live: UNKNOWN_MACRO is not defined */
+	#endif
+#if FOO(1)
+/* live: the condition cannot be decided */
+#endif
+int live = 1; # if 0 starts no conditional after code
+/* live: still after the '#' above */
@@ -0,0 +1,21 @@
+/* conditional directives longer than one event (folded with -D CONFIG_NET):
+ * their conditions cannot be kept, but they must still be tracked */
+
+#if 0
+int dead_a;
+#if defined(LONG_NAME_000) || defined(LONG_NAME_001) || defined(LONG_NAME_002) || defined(LONG_NAME_003) || defined(LONG_NAME_004) || defined(LONG_NAME_005) || defined(LONG_NAME_006) || defined(LONG_NAME_007) || defined(LONG_NAME_008) || defined(LONG_NAME_009) || defined(LONG_NAME_010) || defined(LONG_NAME_011) || defined(LONG_NAME_012) || defined(LONG_NAME_013) || defined(LONG_NAME_014) || defined(LONG_NAME_015) || defined(LONG_NAME_016) || defined(LONG_NAME_017) || defined(LONG_NAME_018) || defined(LONG_NAME_019) || defined(LONG_NAME_020) || defined(LONG_NAME_021) || defined(LONG_NAME_022) || defined(LONG_NAME_023) || defined(LONG_NAME_024) || defined(LONG_NAME_025) || defined(LONG_NAME_026) || defined(LONG_NAME_027) || defined(LONG_NAME_028) || defined(LONG_NAME_029) || defined(LONG_NAME_030) || defined(LONG_NAME_031) || defined(LONG_NAME_032) || defined(LONG_NAME_033) || defined(LONG_NAME_034) || defined(LONG_NAME_035) || defined(LONG_NAME_036) || defined(LONG_NAME_037) || defined(LONG_NAME_038) || defined(LONG_NAME_039) || defined(LONG_NAME_040) || defined(LONG_NAME_041) || defined(LONG_NAME_042) || defined(LONG_NAME_043) || defined(LONG_NAME_044) || defined(LONG_NAME_045) || defined(LONG_NAME_046) || defined(LONG_NAME_047) || defined(LONG_NAME_048) || defined(LONG_NAME_049) || defined(LONG_NAME_050) || defined(LONG_NAME_051) || defined(LONG_NAME_052) || defined(LONG_NAME_053) || defined(LONG_NAME_054) || defined(LONG_NAME_055) || defined(LONG_NAME_056) || defined(LONG_NAME_057) || defined(LONG_NAME_058) || defined(LONG_NAME_059)
+int dead_b;
+#endif
+int dead_c; /* still dead after the nested #endif */
+#endif
+
+#ifdef CONFIG_NET
+#if defined(LONG_NAME_000) || defined(LONG_NAME_001) || defined(LONG_NAME_002) || defined(LONG_NAME_003) || defined(LONG_NAME_004) || defined(LONG_NAME_005) || defined(LONG_NAME_006) || defined(LONG_NAME_007) || defined(LONG_NAME_008) || defined(LONG_NAME_009) || defined(LONG_NAME_010) || defined(LONG_NAME_011) || defined(LONG_NAME_012) || defined(LONG_NAME_013) || defined(LONG_NAME_014) || defined(LONG_NAME_015) || defined(LONG_NAME_016) || defined(LONG_NAME_017) || defined(LONG_NAME_018) || defined(LONG_NAME_019) || defined(LONG_NAME_020) || defined(LONG_NAME_021) || defined(LONG_NAME_022) || defined(LONG_NAME_023) || defined(LONG_NAME_024) || defined(LONG_NAME_025) || defined(LONG_NAME_026) || defined(LONG_NAME_027) || defined(LONG_NAME_028) || defined(LONG_NAME_029) || defined(LONG_NAME_030) || defined(LONG_NAME_031) || defined(LONG_NAME_032) || defined(LONG_NAME_033) || defined(LONG_NAME_034) || defined(LONG_NAME_035) || defined(LONG_NAME_036) || defined(LONG_NAME_037) || defined(LONG_NAME_038) || defined(LONG_NAME_039) || defined(LONG_NAME_040) || defined(LONG_NAME_041) || defined(LONG_NAME_042) || defined(LONG_NAME_043) || defined(LONG_NAME_044) || defined(LONG_NAME_045) || defined(LONG_NAME_046) || defined(LONG_NAME_047) || defined(LONG_NAME_048) || defined(LONG_NAME_049) || defined(LONG_NAME_050) || defined(LONG_NAME_051) || defined(LONG_NAME_052) || defined(LONG_NAME_053) || defined(LONG_NAME_054) || defined(LONG_NAME_055) || defined(LONG_NAME_056) || defined(LONG_NAME_057) || defined(LONG_NAME_058) || defined(LONG_NAME_059)
+/* live: the long condition is unknown */
+#else
+/* live: so is its #else */
+#endif
+/* live: CONFIG_NET */
+#else
+int no_net;
+#endif
@@ -0,0 +1,16 @@
+/* gzip round trip: the compressed page must decompress to the plain one */
+#include <stdio.h>
+#include "sample.h"
+
+#define COUNT 16
+
+// one block comment and one line comment per copy of this file
+int main(void)
+{
+    int values[COUNT] = { 0 };
+
+    for (int i = 0; i < COUNT; i++)
+        values[i] = i * 2;
+    printf("%d\n", values[COUNT - 1]);
+    return 0;
+}
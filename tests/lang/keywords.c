@@ -0,0 +1,19 @@
+/* reserved keywords, numbers and literals of C */
+#include <stdio.h>
+
+static const unsigned int limit = 0x1Fu;
+
+int main(void)
+{
+	double scale = 1.5e-3;
+	char quote = '\'';
+	const char *msg = "tab\t\"quoted\"";
+
+	for(int idx = 0; idx < 10; idx++)
+	{
+		if(idx % 2 == 0)
+			continue;
+		printf("%s %c %d\n", msg, quote, idx);
+	}
+	return sizeof(scale) > 4 ? 0 : 1; // integer_ends_here
+}
@@ -0,0 +1,25 @@
+// reserved keywords of C++ next to names containing them
+#include <vector>
+
+namespace demo {
+
+template <typename T>
+class Box final
+{
+public:
+	explicit Box(T value) : value_(value) {}
+	virtual ~Box() = default;
+	bool operator==(const Box &other) const noexcept { return value_ == other.value_; }
+private:
+	T value_;
+};
+
+}
+
+int classify(int newValue)
+{
+	auto box = new demo::Box<int>(newValue);
+	bool same = *box == demo::Box<int>(42);
+	delete box;
+	return same ? 0x2a : 3'000;
+}
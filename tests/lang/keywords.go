@@ -0,0 +1,23 @@
+// reserved keywords of Go
+package main
+
+import "fmt"
+
+type point struct {
+	x, y float64
+}
+
+func (p point) scaled(factor float64) point {
+	return point{p.x * factor, p.y * factor}
+}
+
+func main() {
+	ch := make(chan rune, 1)
+	defer close(ch)
+	go func() { ch <- 'g' }()
+	select {
+	case r := <-ch:
+		fmt.Println(`raw "string"`, r, point{1, 2.5}.scaled(2))
+	default:
+	}
+}
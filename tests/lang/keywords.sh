@@ -0,0 +1,16 @@
+#!/bin/sh
+# reserved words of the shell, only as whole words
+for name in alpha beta; do
+	if [ "$name" = alpha ]; then
+		echo 'single $name' "double $name"
+	elif test -n "$name"; then
+		echo done_with "$name"
+	fi
+done
+
+case "$1" in
+	start) echo starting ;;
+	*) exit 2 ;;
+esac
+
+while false; do :; done
@@ -0,0 +1,167 @@
+#!/bin/sh
+#
+# Regression tests: runs s2html on the inputs below tests/ and compares the
+# results with the expected files next to them.
+#
+# Usage: tests/run.sh [path to s2html]    (default ./s2html)
+#
+# Set UPDATE=1 to rewrite the expected files from the current output.
+
+S2HTML=$(cd "$(dirname "${1:-./s2html}")" && pwd)/$(basename "${1:-./s2html}")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+failed=0
+
+trap 'rm -rf "$WORK"' EXIT
+
+# compares a result with its expected file
+check()
+{
+    name=$1; result=$2; expected=$3
+
+    if [ -n "$UPDATE" ]; then
+        cp "$result" "$expected"
+    fi
+    if cmp -s "$result" "$expected"; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        diff "$expected" "$result" | head -20
+        failed=$((failed + 1))
+    fi
+}
+
+if [ ! -x "$S2HTML" ]; then
+    echo "s2html not found at $S2HTML"
+    exit 1
+fi
+
+# Analytics line counts: one report per input
+for src in "$TESTS"/stats/*.c "$TESTS"/stats/*.go "$TESTS"/stats/*.sh; do
+    (cd "$TESTS/stats" && "$S2HTML" -s "$(basename "$src")") > "$WORK/report"
+    check "stats $(basename "$src")" "$WORK/report" "$src.expected"
+done
+
+# Lexing: keywords, numbers and literals of every language are their own
+# events, in regular and compact (merged spans, short class names) output
+for src in "$TESTS"/lang/keywords.*; do
+    case "$src" in *.expected) continue ;; esac
+    for mode in "" -c; do
+        "$S2HTML" $mode "$src" "$WORK/$(basename "$src")$mode" > /dev/null
+        check "lang $(basename "$src")${mode:+ $mode}" "$WORK/$(basename "$src")$mode.html" "$src$mode.html.expected"
+    done
+done
+# compact output links a stylesheet generated next to it
+check "lang styles.min.css" "$WORK/styles.min.css" "$TESTS/lang/styles.min.css.expected"
+
+# Invalid UTF-8: every invalid sequence is shown as U+FFFD and counted
+"$S2HTML" "$TESTS/utf8/invalid.c" "$WORK/invalid" > "$WORK/invalid.log"
+check "utf8 invalid.c" "$WORK/invalid.html" "$TESTS/utf8/invalid.c.html.expected"
+if grep -q "Warning!!! 3 Invalid UTF-8 Sequences" "$WORK/invalid.log" &&
+    (cd "$TESTS/utf8" && "$S2HTML" -s invalid.c) | grep -qx "invalid_utf8 3"; then
+    echo "ok   utf8 invalid.c replacements counted"
+else
+    echo "FAIL utf8 invalid.c replacements counted"
+    failed=$((failed + 1))
+fi
+
+# Conditional folding: branches decided by -D are collapsed, their text escaped
+for mode in "" -c; do
+    "$S2HTML" $mode -D CONFIG_NET -D DEBUG=0 "$TESTS/fold/config.c" "$WORK/config$mode" > /dev/null
+    check "fold config.c${mode:+ $mode}" "$WORK/config$mode.html" "$TESTS/fold/config.c$mode.html.expected"
+done
+"$S2HTML" -D CONFIG_NET "$TESTS/fold/long.c" "$WORK/long" > /dev/null
+check "fold long.c" "$WORK/long.html" "$TESTS/fold/long.c.html.expected"
+# a pipe cannot be mapped or seeked, it is read into memory first
+cat "$TESTS/fold/config.c" | "$S2HTML" -D CONFIG_NET -D DEBUG=0 /dev/stdin "$WORK/stdin" > /dev/null
+check "fold config.c from a pipe" "$WORK/stdin.html" "$TESTS/fold/config.c.html.expected"
+
+# Themes: a theme file replaces the page and token markup, an invalid line
+# stops the program before anything is converted
+"$S2HTML" -T "$TESTS/theme/custom.theme" -D CONFIG_NET -D DEBUG=0 "$TESTS/fold/config.c" "$WORK/themed" > /dev/null
+check "theme custom.theme" "$WORK/themed.html" "$TESTS/theme/config.c.html.expected"
+for theme in broken marker; do
+    "$S2HTML" -T "$TESTS/theme/$theme.theme" "$TESTS/fold/config.c" "$WORK/$theme" > "$WORK/$theme.log"
+    status=$?
+    if [ $status -eq 1 ] && [ ! -e "$WORK/$theme.html" ] &&
+        grep -q "Error!!! Invalid Theme .*$theme.theme, Line 3" "$WORK/$theme.log"; then
+        echo "ok   theme $theme.theme rejected"
+    else
+        echo "FAIL theme $theme.theme rejected (exit $status)"
+        failed=$((failed + 1))
+    fi
+done
+
+# Compressed output: decompresses to the page, also when it spans several
+# blocks compressed in parallel
+"$S2HTML" -z "$TESTS/gzip/sample.c" "$WORK/sample" > /dev/null
+gzip -dc "$WORK/sample.html.gz" > "$WORK/sample.html"
+check "gzip sample.c" "$WORK/sample.html" "$TESTS/gzip/sample.c.html.expected"
+for copy in $(seq 3000); do cat "$TESTS/gzip/sample.c"; done > "$WORK/large.c"
+"$S2HTML" "$WORK/large.c" "$WORK/large" > /dev/null
+"$S2HTML" -z "$WORK/large.c" "$WORK/large" > /dev/null
+gzip -dc "$WORK/large.html.gz" > "$WORK/large.gunzip.html"
+check "gzip large.c" "$WORK/large.gunzip.html" "$WORK/large.html"
+# one gzip member: the trailer holds the length of the whole page, not just
+# of the last block
+if gzip -t "$WORK/large.html.gz" &&
+    [ "$(tail -c 4 "$WORK/large.html.gz" | od -An -tu4 | tr -d ' ')" -eq "$(wc -c < "$WORK/large.html")" ]; then
+    echo "ok   gzip large.c is one member"
+else
+    echo "FAIL gzip large.c is one member"
+    failed=$((failed + 1))
+fi
+
+# Mapped output: sources of 1 MB or more are rendered into a mapping of the
+# output file, which must match the streamed (compressed) page, also when the
+# markup outgrows the first size estimate
+for copy in $(seq 60000); do echo "<&><&><&><&><&><&><&><&> /* <&> */"; done > "$WORK/escape.c"
+"$S2HTML" "$WORK/escape.c" "$WORK/escape" > /dev/null
+"$S2HTML" -z "$WORK/escape.c" "$WORK/escape" > /dev/null
+gzip -dc "$WORK/escape.html.gz" > "$WORK/escape.gunzip.html"
+check "mapped escape.c" "$WORK/escape.html" "$WORK/escape.gunzip.html"
+
+# Shard assignment: depends only on the manifest, and the merge must see
+# every manifest entry exactly once
+cp -r "$TESTS/shard" "$WORK/shard"
+for shard in 1 2; do
+    (cd "$WORK/shard" && "$S2HTML" -s --shard $shard/2 manifest.txt > /dev/null 2>&1)
+    check "shard $shard/2" "$WORK/shard/manifest.txt.shard-$shard-of-2" "$TESTS/shard/manifest.txt.shard-$shard-of-2.expected"
+done
+(cd "$WORK/shard" && "$S2HTML" --merge merged.txt manifest.txt.shard-1-of-2 manifest.txt.shard-2-of-2 > /dev/null)
+check "shard merge" "$WORK/shard/merged.txt" "$TESTS/shard/merged.txt.expected"
+(cd "$WORK/shard" && grep -v "a.c$" manifest.txt.shard-2-of-2 > incomplete &&
+    "$S2HTML" --merge broken.txt manifest.txt.shard-1-of-2 incomplete > /dev/null)
+if [ $? -eq 7 ] && [ ! -e "$WORK/shard/broken.txt" ]; then
+    echo "ok   shard merge of incomplete results fails"
+else
+    echo "FAIL shard merge of incomplete results fails"
+    failed=$((failed + 1))
+fi
+
+# Tracing: the trace is valid JSON at exit, and in watch mode (only ever
+# stopped by a signal) after every burst, each burst appended to it
+mkdir "$WORK/watch"
+cp "$TESTS/gzip/sample.c" "$WORK/watch/sample.c"
+"$S2HTML" -t "$WORK/trace.json" -z "$WORK/watch/sample.c" > /dev/null
+"$S2HTML" -w -t "$WORK/watch/trace.json" "$WORK/watch/sample.c" > /dev/null &
+watcher=$!
+sleep 1
+echo "/* changed */" >> "$WORK/watch/sample.c"
+sleep 1
+kill $watcher
+wait $watcher 2> /dev/null
+if python3 -m json.tool "$WORK/trace.json" > /dev/null &&
+    python3 -m json.tool "$WORK/watch/trace.json" > /dev/null &&
+    [ "$(grep -c '"name":"convert"' "$WORK/watch/trace.json")" -eq 2 ]; then
+    echo "ok   trace is valid JSON"
+else
+    echo "FAIL trace is valid JSON"
+    failed=$((failed + 1))
+fi
+
+if [ $failed -ne 0 ]; then
+    echo "$failed test(s) failed"
+    exit 1
+fi
+echo "all tests passed"
@@ -0,0 +1,4 @@
+echo $# ${#x} # c
+# full
+
+export x=1
@@ -0,0 +1,17 @@
+/* every kind of directive is counted, not only conditionals */
+#include <stdio.h>
+#include "local.h"
+  #  define TWICE(x) \
+	((x) * 2)
+#undef TWICE
+#pragma once
+#if defined(DEBUG)
+#error "debug # builds"
+#elif 0
+#else
+#endif
+
+/* # not a directive */
+int hash = '#';
+const char *text = "# nor this";
+int x = 1; # not at the start of the line
@@ -0,0 +1,7 @@
+/* a
+
+ b */ int x; // c
+// only
+  
+char *s = "/* no */";
+return 0;
\ No newline at end of file
@@ -0,0 +1,7 @@
+package main
+
+var s = `raw // not a comment
+/* nor this */ \n`
+// real comment
+var t = "x" /* c */
+var u = `unterminated
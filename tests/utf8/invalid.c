@@ -0,0 +1,2 @@
+/* invalid UTF-8 is replaced: Latin-1 , a cut  sequence */
+const char *name = "caf"; /* valid: café */